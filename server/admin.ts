@@ -21,13 +21,17 @@ async function ask(x: AdminCommand) {
 		console.log(`Status:\n\tPlayers connected: ${res.players.length==0 ? "(none)" : res.players.join(", ")}`
 			+ `\n\tActive game: ${res.game==null ? "(none)" : `${res.game.type=="mine" ? "Minesweeper" : "Wikirace"}, started ${new Date(res.game.start).toLocaleString()}`}\n`)
 	}
+	else if (res.type=="stats") {
+		if (res.engines==null) console.log("No engine stats (libkiosk needs to be built with ENGINE_STATS)");
+		else console.log(JSON.stringify(res.engines, null, 2));
+	}
 	else console.log("Response ok.");
 }
 
 const inputLoop = ()=>(async () => {
 	const cmd = await enquirer.prompt({
 		type: "select", name: "command",
-		choices: ["reset", "send", "status", "exit"],
+		choices: ["reset", "send", "status", "stats", "reload graph", "exit"],
 		message: "enter a command"
 	}) as {command: string};
 
@@ -46,6 +50,11 @@ const inputLoop = ()=>(async () => {
 		}
 	} else if (cmd.command=="status") {
 		ask({type: "status"});
+	} else if (cmd.command=="stats") {
+		ask({type: "stats"});
+	} else if (cmd.command=="reload graph") {
+		console.log("reloading data.bin...");
+		ask({type: "reloadGraph"});
 	} else if (cmd.command=="exit") {
 		console.log("exiting...");
 		exit(0);
@@ -0,0 +1,248 @@
+#define MINESWEEPER_NO_MAIN
+#include "main.cpp"
+
+#include <benchmark/benchmark.h>
+
+//allocations made through operator new. with mimalloc, vec goes through mi_stl_allocator instead,
+//so release builds report mimalloc's committed memory
+#ifdef BUILD_DEBUG
+static size_t n_alloc=0;
+
+[[gnu::noinline]] void* operator new(size_t n) {
+	n_alloc++;
+	if (void* p = malloc(n)) return p;
+	throw bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept {free(p);}
+[[gnu::noinline]] void operator delete(void* p, size_t) noexcept {free(p);}
+#endif
+
+struct AllocCounter {
+	#ifdef BUILD_DEBUG
+	size_t start=n_alloc;
+	#endif
+
+	void report(benchmark::State& st) {
+		#ifdef BUILD_DEBUG
+		st.counters["allocs"] = benchmark::Counter(n_alloc-start, benchmark::Counter::kAvgIterations);
+		#else
+		size_t elapsed, user, sys, rss, peak_rss, commit, peak_commit, faults;
+		mi_process_info(&elapsed, &user, &sys, &rss, &peak_rss, &commit, &peak_commit, &faults);
+		st.counters["peak_commit_mb"] = peak_commit/1e6;
+		#endif
+	}
+};
+
+void report_cache(benchmark::State& st, Solver<> const& s) {
+	size_t n = s.n_cache_hit+s.n_cache_miss;
+	st.counters["cache_hit"] = n ? double(s.n_cache_hit)/n : 0;
+	st.counters["cache_size"] = s.cache.size();
+}
+
+struct Fixture {
+	int h,w,n_mine;
+	vec<int> known;
+};
+
+//boards from when the solver was written, and midgame positions of seeded generated boards
+Fixture hand_fixture() {
+	return {9,9,35, {
+		-1, -1,  2,  0,  1, -1, -1, -1, -1,
+		-1, -1,  3,  1,  3,  3, -1, -1, -1,
+		-1, -1,  2, -1,  2, -1,  4, -1, -1,
+		-1,  4,  2,  1,  2,  1,  2, -1, -1,
+		-1, -1,  3,  1,  0,  0,  1,  3,  3,
+		-1, -1, -1,  4,  2,  1,  0,  1, -1,
+		-1, -1, -1, -1, -1,  4,  2,  3,  2,
+		-1, -1, -1, -1, -1, -1, -1,  3, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1,
+	}};
+}
+
+Fixture midgame_fixture(int h, int w, int n_mine, uint64_t seed) {
+	for (;; seed++) {
+		Generator<> gen(h,w,h/2,w/2,n_mine,seed);
+		if (!gen.generate() || gen.local) continue;
+
+		gen.move_stack.resize(gen.move_stack.size()/2);
+		gen.reset();
+		return {h,w,n_mine,gen.known};
+	}
+}
+
+array<Fixture,4> const& fixtures() {
+	static array<Fixture,4> out = {
+		hand_fixture(),
+		midgame_fixture(16,16,40,1),
+		midgame_fixture(16,30,99,1),
+		midgame_fixture(30,30,200,1)
+	};
+
+	return out;
+}
+
+void fixture_args(benchmark::internal::Benchmark* b) {
+	b->ArgName("fixture");
+	for (int i=0; i<fixtures().size(); i++) b->Arg(i);
+}
+
+//preset picks the Generator compiled for the size like generate_board does, instead of Generator<>
+static void BM_Generate(benchmark::State& st) {
+	int h=st.range(0), w=st.range(1), n_mine=st.range(2);
+	bool preset=st.range(3);
+	uint64_t seed=0;
+	int n_ok=0, n=0;
+
+	auto generate = [&]<int H, int W>(BoardSize<H,W>) {
+		Generator<H,W> gen(h,w,h/2,w/2,n_mine,seed++);
+		return gen.generate();
+	};
+
+	AllocCounter allocs;
+	for (auto _: st) {
+		bool ok = preset ? with_board_size(h,w,generate) : generate(BoardSize<0,0>(h,w));
+		benchmark::DoNotOptimize(ok);
+		n_ok+=ok, n++;
+	}
+
+	st.counters["success"] = double(n_ok)/n;
+	allocs.report(st);
+}
+
+BENCHMARK(BM_Generate)->ArgNames({"h","w","mines","preset"})
+	->Args({9,9,10,0})->Args({16,16,40,0})->Args({16,30,99,0})->Args({50,50,500,0})
+	->Args({9,9,10,1})->Args({16,16,40,1})->Args({16,30,99,1})
+	->Unit(benchmark::kMillisecond);
+
+//the whole frontier, cold: a new cache every iteration
+static void BM_CheckCold(benchmark::State& st) {
+	Fixture const& f = fixtures()[st.range(0)];
+
+	AllocCounter allocs;
+	size_t hit=0, miss=0;
+	for (auto _: st) {
+		Solver<> s(f.h,f.w,f.n_mine);
+		s.set_known(f.known);
+		benchmark::DoNotOptimize(s.check(s.state));
+		hit+=s.n_cache_hit, miss+=s.n_cache_miss;
+	}
+
+	st.counters["cache_hit"] = hit+miss ? double(hit)/(hit+miss) : 0;
+	allocs.report(st);
+}
+
+BENCHMARK(BM_CheckCold)->Apply(fixture_args)->Unit(benchmark::kMicrosecond);
+
+//simple_solve alone on the whole frontier, like the first step of check
+static void BM_SimpleSolve(benchmark::State& st) {
+	Fixture const& f = fixtures()[st.range(0)];
+	Solver<> s(f.h,f.w,f.n_mine);
+	s.set_known(f.known);
+
+	for (auto _: st) {
+		Solver<>::State state = s.state;
+		int mine_offset=0;
+		Solver<>::CheckCell cell;
+
+		for (int ci=0; ci<state.size(); ci++) s.tmp_cell_idx[state[ci].position()]=ci;
+		benchmark::DoNotOptimize(s.simple_solve(state, mine_offset, cell));
+		for (Cell c: state) s.tmp_cell_idx[c.position()]=-1;
+	}
+
+	st.SetItemsProcessed(st.iterations()*s.state.size());
+}
+
+BENCHMARK(BM_SimpleSolve)->Apply(fixture_args);
+
+//can_be_mine for each frontier cell in turn with the cache kept, like the generator and hints use it
+static void BM_CanBeMine(benchmark::State& st) {
+	Fixture const& f = fixtures()[st.range(0)];
+	Solver<> s(f.h,f.w,f.n_mine);
+	s.set_known(f.known);
+
+	AllocCounter allocs;
+	int ci=0;
+	for (auto _: st) {
+		benchmark::DoNotOptimize(s.can_be_mine(s.state[ci].position()));
+		ci = (ci+1)%s.state.size();
+	}
+
+	report_cache(st, s);
+	allocs.report(st);
+}
+
+BENCHMARK(BM_CanBeMine)->Apply(fixture_args)->Unit(benchmark::kMicrosecond);
+
+//the whole frontier in one check, warm
+static void BM_MinePossible(benchmark::State& st) {
+	Fixture const& f = fixtures()[st.range(0)];
+	Solver<> s(f.h,f.w,f.n_mine);
+	s.set_known(f.known);
+
+	for (auto _: st) benchmark::DoNotOptimize(s.mine_possible());
+	report_cache(st, s);
+}
+
+BENCHMARK(BM_MinePossible)->Apply(fixture_args)->Unit(benchmark::kMicrosecond);
+
+//a hint after every move of a game with one solver, like the server keeps per game. positions of a few seeded
+//generated boards, each iteration plays one of them from the start. canonical turns on Solver::canonical_keys,
+//preset uses the Solver compiled for the size like libkiosk does
+static void BM_HintGame(benchmark::State& st) {
+	int h=st.range(0), w=st.range(1), n_mine=st.range(2);
+	bool canonical=st.range(3), preset=st.range(4);
+
+	vec<vec<vec<int>>> games;
+	for (uint64_t seed=1; games.size()<4; seed++) {
+		Generator<> gen(h,w,h/2,w/2,n_mine,seed);
+		if (!gen.generate() || gen.local) continue;
+
+		auto moves = gen.move_stack;
+		auto& game = games.emplace_back();
+		for (int k=0; k<=moves.size(); k++) {
+			gen.move_stack.assign(moves.begin(), moves.begin()+k);
+			gen.reset();
+			game.push_back(gen.known);
+		}
+	}
+
+	AllocCounter allocs;
+	size_t hit=0, miss=0;
+	auto play = [&]<int H, int W>(BoardSize<H,W>, vec<vec<int>> const& game) {
+		Solver<H,W> s(h,w,n_mine);
+		s.canonical_keys=canonical;
+		s.set_known(vec<int>(h*w,-1));
+
+		vec<int> changed;
+		for (int k=0; k<game.size(); k++) {
+			changed.clear();
+			for (int x=0; x<h*w; x++) if (game[k][x]!=s.known[x]) changed.push_back(x);
+
+			s.update_known(changed, game[k]);
+			benchmark::DoNotOptimize(s.hint());
+		}
+
+		hit+=s.n_cache_hit, miss+=s.n_cache_miss;
+	};
+
+	int gi=0;
+	for (auto _: st) {
+		auto const& game = games[gi];
+		gi = (gi+1)%games.size();
+
+		if (preset) with_board_size(h, w, [&](auto size) {play(size, game);});
+		else play(BoardSize<0,0>(h,w), game);
+	}
+
+	st.counters["cache_hit"] = hit+miss ? double(hit)/(hit+miss) : 0;
+	allocs.report(st);
+}
+
+BENCHMARK(BM_HintGame)->ArgNames({"h","w","mines","canonical","preset"})
+	->Args({9,9,10,0,0})->Args({16,16,40,0,0})->Args({16,30,99,0,0})
+	->Args({9,9,10,1,0})->Args({16,16,40,1,0})->Args({16,30,99,1,0})
+	->Args({9,9,10,0,1})->Args({16,16,40,0,1})->Args({16,30,99,0,1})
+	->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
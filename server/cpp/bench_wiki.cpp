@@ -0,0 +1,192 @@
+#define WIKI_NO_MAIN
+#include "wiki.cpp"
+
+#include <chrono>
+#include <filesystem>
+#include <benchmark/benchmark.h>
+
+//writes a data.bin with n pages and power law degrees:
+//out degrees are pareto distributed, targets are picked by a popularity rank so in degrees are heavy tailed too
+void write_graph(string const& path, int n, double avg_degree, uint64_t seed) {
+	mt19937_64 rng(seed);
+	uniform_real_distribution<> unif(0,1);
+
+	//pareto with exponent 2.2 has mean 6/1.2 * x_min
+	double x_min = avg_degree*1.2/6;
+	gtl::vector<int> popular(n);
+	for (int i=0; i<n; i++) popular[i]=i;
+	shuffle(popular.begin(), popular.end(), rng);
+
+	gtl::vector<gtl::vector<int>> adj(n), rev_adj(n);
+	for (int i=0; i<n; i++) {
+		int deg = min<double>(n-1, x_min*pow(1-unif(rng), -1/1.2));
+		for (int k=0; k<deg; k++) {
+			int to = popular[min<int>(n-1, n*pow(unif(rng), 2.5))];
+			if (to!=i) adj[i].push_back(to);
+		}
+
+		sort(adj[i].begin(), adj[i].end());
+		adj[i].erase(unique(adj[i].begin(), adj[i].end()), adj[i].end());
+		for (int to: adj[i]) rev_adj[to].push_back(i);
+	}
+
+	ofstream data(path, ios::binary);
+	auto write_int = [&data](int x) {
+		x=convert(x);
+		data.write(reinterpret_cast<char*>(&x), sizeof(int));
+	};
+
+	auto write_int64 = [&data](int64_t x) {
+		x=convert(x);
+		data.write(reinterpret_cast<char*>(&x), sizeof(int64_t));
+	};
+
+	//ids are sorted with gaps, like page ids left after dropping redirects
+	write_int(n);
+	for (int i=0; i<n; i++) write_int64(3*int64_t(i)+1);
+
+	int cur=0;
+	for (auto const* a: {&adj, &rev_adj}) {
+		for (auto const& l: *a) write_int(cur+=l.size());
+	}
+
+	for (auto const* a: {&adj, &rev_adj}) {
+		for (auto const& l: *a) for (int y: l) write_int(y);
+	}
+}
+
+static unique_ptr<Data> graph;
+
+static void BM_FromId(benchmark::State& st) {
+	minstd_rand rng(1);
+	for (auto _: st) {
+		int i = uniform_int_distribution<>(0,graph->n-1)(rng);
+		benchmark::DoNotOptimize(graph->from_id(3*int64_t(i)+1));
+	}
+}
+
+BENCHMARK(BM_FromId);
+
+static void BM_GotoAdj(benchmark::State& st) {
+	minstd_rand rng(1);
+	size_t n_edge=0;
+	for (auto _: st) {
+		int i = uniform_int_distribution<>(0,graph->n-1)(rng);
+		int adj_l = graph->goto_adj(i, st.range(0));
+		n_edge+=adj_l;
+		while (adj_l--) benchmark::DoNotOptimize(graph->read());
+	}
+
+	st.SetItemsProcessed(n_edge);
+}
+
+BENCHMARK(BM_GotoAdj)->ArgName("rev")->Arg(0)->Arg(1);
+
+//latency over random pairs, reported as percentiles since it depends a lot on the pair.
+//with banned_pct, that % of pages (picked at random) can't be on paths
+static void BM_PathBetween(benchmark::State& st) {
+	minstd_rand rng(1);
+	gtl::vector<double> times;
+	int n_found=0;
+
+	gtl::vector<int64_t> ban_ids;
+	for (int i=0; i<graph->n; i++) {
+		if (uniform_int_distribution<>(0,99)(rng)<st.range(0)) ban_ids.push_back(3*int64_t(i)+1);
+	}
+
+	gtl::bit_vector banned = banned_pages(*graph, ban_ids);
+
+	for (auto _: st) {
+		int s = uniform_int_distribution<>(0,graph->n-1)(rng);
+		int t = uniform_int_distribution<>(0,graph->n-1)(rng);
+
+		auto t0 = chrono::steady_clock::now();
+		auto path = path_between(*graph, s, t, nullptr, ban_ids.empty() ? nullptr : &banned);
+		double dt = chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+
+		st.SetIterationTime(dt);
+		times.push_back(dt);
+		n_found+=!path.empty();
+	}
+
+	sort(times.begin(), times.end());
+	auto pct = [&](double p) {return times[min<size_t>(times.size()-1, p*times.size())]*1e6;};
+	st.counters["p50_us"]=pct(0.5);
+	st.counters["p90_us"]=pct(0.9);
+	st.counters["p99_us"]=pct(0.99);
+	st.counters["found"]=double(n_found)/times.size();
+}
+
+BENCHMARK(BM_PathBetween)->ArgName("banned_pct")->Arg(0)->Arg(1)->Arg(10)->UseManualTime()
+	->Unit(benchmark::kMicrosecond);
+
+//n sources sharing a target. a bidirectional search each below min_batch_bfs, one backward search from there
+static void BM_DistancesTo(benchmark::State& st) {
+	minstd_rand rng(2);
+	gtl::vector<int> sources(st.range(0)), out;
+
+	for (auto _: st) {
+		for (int& s: sources) s=uniform_int_distribution<>(0,graph->n-1)(rng);
+		int t = uniform_int_distribution<>(0,graph->n-1)(rng);
+
+		distances_to(*graph, sources, t, out);
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	st.SetItemsProcessed(st.iterations()*st.range(0));
+}
+
+BENCHMARK(BM_DistancesTo)->ArgName("sources")->RangeMultiplier(4)->Range(1,4096)->Unit(benchmark::kMicrosecond);
+
+//time until select finds a pair, for each minDistance the game offers
+static void BM_Select(benchmark::State& st) {
+	minstd_rand rng(321);
+	int n_ok=0, n=0;
+
+	for (auto _: st) {
+		auto res = select(*graph, st.range(0), rng);
+		benchmark::DoNotOptimize(res);
+		n_ok+=res.has_value(), n++;
+	}
+
+	st.counters["success"]=double(n_ok)/n;
+}
+
+BENCHMARK(BM_Select)->ArgName("minDistance")->DenseRange(0,6)->Unit(benchmark::kMillisecond);
+
+//flags besides the benchmark ones:
+//--graph=path to use an existing data.bin, otherwise one is generated with --nodes=n (default 200000) and --degree=d (default 20)
+int main(int argc, char** argv) {
+	benchmark::Initialize(&argc, argv);
+
+	string path;
+	int n=200000;
+	double degree=20;
+	for (int i=1; i<argc; i++) {
+		string arg=argv[i];
+		auto value = [&](string const& flag) -> optional<string> {
+			if (arg.starts_with(flag+"=")) return arg.substr(flag.size()+1);
+			return nullopt;
+		};
+
+		if (auto p=value("--graph")) path=*p;
+		else if (auto x=value("--nodes")) n=stoi(*x);
+		else if (auto d=value("--degree")) degree=stod(*d);
+		else throw runtime_error("unknown flag "+arg);
+	}
+
+	bool generated=path.empty();
+	if (generated) {
+		path = (filesystem::temp_directory_path()/"bench_wiki.bin").string();
+		cerr<<"writing synthetic graph with "<<n<<" pages to "<<path<<"\n";
+		write_graph(path, n, degree, 1);
+	}
+
+	graph = make_unique<Data>(path);
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+
+	graph.reset();
+	if (generated) filesystem::remove(path);
+	return 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+//C ABI over the minesweeper and wiki engines, so the server can load them in-process (Deno.dlopen) instead of
+//spawning build/main and build/wiki for every query
+//functions returning int32_t give -1 on error, with the message in kiosk_last_error. results go into buffers
+//the caller allocates. handles can be used from any thread, calls on the same handle are serialized
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct kiosk_solver kiosk_solver;
+typedef struct kiosk_graph kiosk_graph;
+typedef struct kiosk_banned kiosk_banned;
+typedef struct kiosk_store kiosk_store;
+typedef struct kiosk_cancel kiosk_cancel;
+
+//message for the last error on this thread, so only useful after a call made on the caller's own thread
+char const* kiosk_last_error(void);
+
+//counters and timers collected so far as json (see stats.hpp), empty unless built with ENGINE_STATS
+//returns the length, which can be more than cap if out was too small
+int32_t kiosk_stats(char* out, int32_t cap);
+
+//like `main h w mines si sj ...`. difficulty is null or {min_deductions, max_deductions, max_depth, min_3bv, max_3bv},
+//cache_path is null or a board cache (needs seeded). out_bits gets (h*w+7)/8 bytes, as with the bits option
+//1 if a board was written, 0 if generation failed
+int32_t kiosk_generate(int32_t h, int32_t w, int32_t mines, int32_t si, int32_t sj, int32_t const* difficulty,
+	uint64_t seed, int32_t seeded, char const* cache_path, uint8_t* out_bits);
+
+//a solver for one board, keeping its cache between hints like `main hint`
+kiosk_solver* kiosk_solver_new(int32_t h, int32_t w, int32_t mines);
+void kiosk_solver_free(kiosk_solver* solver);
+
+//known has h*w cells, -1 for unknown. out_flags gets 1 for cells which are safe, 2 for mines, 0 otherwise,
+//out_prob the probability of each cell being a mine. 1 if written, 0 if no board matches known
+int32_t kiosk_solver_hint(kiosk_solver* solver, int8_t const* known, uint8_t* out_flags, double* out_prob);
+
+//a data.bin written by `wiki extract`, kept open between queries
+kiosk_graph* kiosk_graph_open(char const* path);
+void kiosk_graph_free(kiosk_graph* graph);
+
+//loads path (null for the current one, e.g. after extract replaced it), checks it against its
+//checksum and swaps it in. queries already running finish on the old version. 1 if swapped, -1 if the file
+//can't be loaded or doesn't check out, in which case the old version stays
+int32_t kiosk_graph_reload(kiosk_graph* graph, char const* path);
+
+//pages queries can be told to avoid (see kiosk_graph_distance). the bitset searches use is built on first use
+//with each graph version, so one set can be reused for every query of a game. can be shared between graphs
+kiosk_banned* kiosk_banned_new(int64_t const* ids, int32_t n);
+void kiosk_banned_free(kiosk_banned* banned);
+
+//the graph queries take banned, which is null or pages that paths can't go through (and that select won't pick)
+
+//shortest path between two page ids, like `wiki distance`. writes up to cap page ids including both ends
+//returns the # of pages on the path, 0 if there is none. -1 if a page doesn't exist or cap is too small
+int32_t kiosk_graph_distance(kiosk_graph* graph, int64_t from, int64_t to, kiosk_banned* banned,
+	int64_t* out_path, int32_t cap);
+
+//every shortest path between two page ids, like `wiki paths`: out_n_paths gets how many there are (saturating),
+//out_width the # of pages that can be at each position on one, and k of them are sampled uniformly. sampled
+//path i goes to out_paths[i*cap..] and the # of links at each of its pages that stay on a shortest path to
+//out_choices[i*cap..]. returns the # of pages on a shortest path, 0 if there is none,
+//-1 if a page doesn't exist or cap is too small
+int32_t kiosk_graph_paths(kiosk_graph* graph, int64_t from, int64_t to, kiosk_banned* banned, int32_t k, uint64_t seed,
+	int32_t cap, uint64_t* out_n_paths, int32_t* out_width, int64_t* out_paths, int32_t* out_choices);
+
+//distances from n pages to one page, for batching queries that share a target (one backward search for big batches)
+//out[i] is the distance from from[i], -1 if there's no path, -2 if the page doesn't exist
+//cancel can be null. returns 1 when done, 0 if cancelled first
+int32_t kiosk_graph_distances(kiosk_graph* graph, int64_t const* from, int32_t n, int64_t to, kiosk_banned* banned,
+	int32_t* out, kiosk_cancel* cancel);
+
+//random pair of pages at least min_distance apart, like `wiki select`. out gets {start id, end id, distance}
+//1 if found, 0 if not
+int32_t kiosk_graph_select(kiosk_graph* graph, int32_t min_distance, kiosk_banned* banned, uint64_t seed, int64_t* out);
+
+//a pages.bin written by `wiki build-store`, mapped while open
+kiosk_store* kiosk_store_open(char const* path);
+void kiosk_store_free(kiosk_store* store);
+
+//a page by id, or by title (redirects included) if title isn't null, as json shaped like the parse api's
+//parse object: {title, pageid, text, sections: [{toclevel, anchor, line}]}
+//returns the length, which can be more than cap if out was too small. 0 if the page isn't stored
+int32_t kiosk_store_page(kiosk_store* store, int64_t id, char const* title, char* out, int32_t cap);
+
+//token for stopping a query from another thread, checked between search levels
+kiosk_cancel* kiosk_cancel_new(void);
+void kiosk_cancel_set(kiosk_cancel* cancel);
+void kiosk_cancel_free(kiosk_cancel* cancel);
+
+#ifdef __cplusplus
+}
+#endif
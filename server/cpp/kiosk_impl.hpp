@@ -0,0 +1,23 @@
+#pragma once
+
+//shared by the libkiosk sources, not part of the C ABI
+
+#include <exception>
+#include <string>
+
+//message for kiosk_last_error, defined in kiosk_mines.cpp
+extern thread_local std::string kiosk_error;
+
+//runs f, turning exceptions into kiosk_last_error and err
+template<class F>
+auto kiosk_try(F f, decltype(f()) err) -> decltype(f()) {
+	try {
+		return f();
+	} catch (std::exception const& e) {
+		kiosk_error = e.what();
+	} catch (...) {
+		kiosk_error = "unknown error";
+	}
+
+	return err;
+}
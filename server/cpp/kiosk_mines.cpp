@@ -0,0 +1,111 @@
+#define MINESWEEPER_NO_MAIN
+#define KIOSK_LIB
+#include "main.cpp"
+
+#include <mutex>
+
+#include "kiosk.h"
+#include "kiosk_impl.hpp"
+
+thread_local string kiosk_error;
+
+extern "C" {
+
+char const* kiosk_last_error() {
+	return kiosk_error.c_str();
+}
+
+int32_t kiosk_stats(char* out, int32_t cap) {
+	stringstream ss;
+	print_stats(ss);
+	string str = ss.str();
+
+	copy_n(str.begin(), min<size_t>(cap, str.size()), out);
+	return str.size();
+}
+
+int32_t kiosk_generate(int32_t h, int32_t w, int32_t mines, int32_t si, int32_t sj, int32_t const* difficulty,
+	uint64_t seed, int32_t seeded, char const* cache_path, uint8_t* out_bits) {
+	return kiosk_try([&]() -> int32_t {
+		Difficulty diff;
+		if (difficulty) {
+			diff = {
+				.min_deductions=difficulty[0], .max_deductions=difficulty[1],
+				.max_depth=difficulty[2], .min_3bv=difficulty[3], .max_3bv=difficulty[4]
+			};
+		}
+
+		BoardKey key {
+			h,w,mines,si,sj,
+			diff.min_deductions, diff.max_deductions, diff.max_depth, diff.min_3bv, diff.max_3bv,
+			seeded ? seed : 0
+		};
+
+		vec<bool> g;
+		if (!generate_board(key, seeded, cache_path ? cache_path : "", g)) return 0;
+
+		fill(out_bits, out_bits+(h*w+7)/8, 0);
+		for (int x=0; x<h*w; x++) if (g[x]) out_bits[x/8] |= 1<<(x%8);
+		return 1;
+	}, -1);
+}
+
+}
+
+//a solver for each size with_board_size picks
+using AnySolver = variant<unique_ptr<Solver<>>, unique_ptr<Solver<9,9>>, unique_ptr<Solver<16,16>>, unique_ptr<Solver<16,30>>>;
+
+struct kiosk_solver {
+	mutex m;
+	AnySolver solver;
+	vec<int> new_known, changed;
+
+	kiosk_solver(int h, int w, int mines): solver(with_board_size(h, w, [&]<int H, int W>(BoardSize<H,W>) {
+		auto out = make_unique<Solver<H,W>>(h,w,mines);
+		out->set_known(vec<int>(h*w,-1));
+		return AnySolver(std::move(out));
+	})), new_known(h*w) {}
+};
+
+extern "C" {
+
+kiosk_solver* kiosk_solver_new(int32_t h, int32_t w, int32_t mines) {
+	return kiosk_try([&]() -> kiosk_solver* {
+		if (h<=0 || w<=0 || int64_t(h)*w>50*50 || mines<0 || mines>=int64_t(h)*w) throw runtime_error("invalid parameters");
+		return new kiosk_solver(h,w,mines);
+	}, nullptr);
+}
+
+void kiosk_solver_free(kiosk_solver* solver) {
+	delete solver;
+}
+
+int32_t kiosk_solver_hint(kiosk_solver* ks, int8_t const* known, uint8_t* out_flags, double* out_prob) {
+	return kiosk_try([&]() -> int32_t {
+		lock_guard lock(ks->m);
+		return visit([&]<int H, int W>(unique_ptr<Solver<H,W>>& ptr) -> int32_t {
+			Solver<H,W>& solver = *ptr;
+
+			ks->changed.clear();
+			for (int i=0; i<solver.sz; i++) {
+				if (known[i]<-1 || known[i]>8) throw runtime_error("invalid board");
+				ks->new_known[i]=known[i];
+				if (known[i]!=solver.known[i]) ks->changed.push_back(i);
+			}
+
+			solver.update_known(ks->changed, ks->new_known);
+			auto res = solver.hint();
+
+			auto const* hint = get_if<typename Solver<H,W>::Hint>(&res);
+			if (!hint) return 0;
+
+			fill(out_flags, out_flags+solver.sz, 0);
+			for (int x: hint->safe) out_flags[x]=1;
+			for (int x: hint->mine) out_flags[x]=2;
+			copy(hint->prob.begin(), hint->prob.end(), out_prob);
+			return 1;
+		}, ks->solver);
+	}, -1);
+}
+
+}
@@ -0,0 +1,228 @@
+#define WIKI_NO_MAIN
+#include "wiki.cpp"
+
+#include <mutex>
+
+#include "kiosk.h"
+#include "kiosk_impl.hpp"
+
+//queries copy d, which gives them their own cursor over the shared mapping, so they run concurrently
+struct GraphVersion {
+	Data d;
+
+	GraphVersion(string const& path): d(path) {}
+};
+
+//queries hold the version they started on, so one replaced by kiosk_graph_reload is freed when the last
+//query on it finishes, and new ones go to the new version without waiting
+struct kiosk_graph {
+	string path;
+	atomic<shared_ptr<GraphVersion>> cur;
+	mutex reload_m;
+
+	kiosk_graph(char const* graph_path): path(graph_path), cur(make_shared<GraphVersion>(graph_path)) {}
+};
+
+//ids, since the graph can be swapped, and the bitset for the version it was last used on
+struct kiosk_banned {
+	mutex m;
+	gtl::vector<int64_t> ids;
+	weak_ptr<GraphVersion> ver;
+	shared_ptr<gtl::bit_vector const> bits;
+
+	shared_ptr<gtl::bit_vector const> for_version(shared_ptr<GraphVersion> const& v) {
+		lock_guard lock(m);
+		if (ver.lock()!=v) {
+			Data d = v->d;
+			bits = make_shared<gtl::bit_vector const>(banned_pages(d, ids));
+			ver = v;
+		}
+
+		return bits;
+	}
+};
+
+//the last page is kept so asking again with a bigger buffer doesn't decompress it twice
+struct kiosk_store {
+	mutex m;
+	PageStore store;
+	int last=-1;
+	string last_json;
+
+	kiosk_store(char const* path): store(path) {}
+};
+
+struct kiosk_cancel {
+	atomic<bool> set=false;
+};
+
+extern "C" {
+
+kiosk_graph* kiosk_graph_open(char const* path) {
+	return kiosk_try([&]() {return new kiosk_graph(path);}, nullptr);
+}
+
+void kiosk_graph_free(kiosk_graph* graph) {
+	delete graph;
+}
+
+int32_t kiosk_graph_reload(kiosk_graph* graph, char const* path) {
+	return kiosk_try([&]() -> int32_t {
+		lock_guard lock(graph->reload_m);
+		string p = path ? path : graph->path;
+
+		//opened first, so what's checked is what gets used even if p is replaced again meanwhile
+		auto ver = make_shared<GraphVersion>(p);
+		if (!ver->d.checksum) throw runtime_error(p+" has no checksum");
+		if (!ver->d.verify()) throw runtime_error(p+" doesn't match its checksum");
+
+		graph->path=p;
+		graph->cur.store(std::move(ver));
+		return 1;
+	}, -1);
+}
+
+int32_t kiosk_graph_distance(kiosk_graph* graph, int64_t from, int64_t to, kiosk_banned* banned,
+	int64_t* out_path, int32_t cap) {
+	return kiosk_try([&]() -> int32_t {
+		auto ver = graph->cur.load();
+		Data d = ver->d;
+		auto bits = banned ? banned->for_version(ver) : nullptr;
+
+		int p1_i = d.from_id(from), p2_i = d.from_id(to);
+		if (p1_i==-1 || p2_i==-1) throw runtime_error("page not found");
+
+		gtl::vector<int> path = p1_i==p2_i ? gtl::vector<int>{p1_i} : path_between(d, p1_i, p2_i, nullptr, bits.get());
+		if (path.size()>cap) throw runtime_error("path doesn't fit");
+
+		for (int i=0; i<path.size(); i++) out_path[i]=d.to_id(path[i]);
+		return path.size();
+	}, -1);
+}
+
+int32_t kiosk_graph_paths(kiosk_graph* graph, int64_t from, int64_t to, kiosk_banned* banned, int32_t k, uint64_t seed,
+	int32_t cap, uint64_t* out_n_paths, int32_t* out_width, int64_t* out_paths, int32_t* out_choices) {
+	return kiosk_try([&]() -> int32_t {
+		auto ver = graph->cur.load();
+		Data d = ver->d;
+		auto bits = banned ? banned->for_version(ver) : nullptr;
+
+		int p1_i = d.from_id(from), p2_i = d.from_id(to);
+		if (p1_i==-1 || p2_i==-1) throw runtime_error("page not found");
+
+		minstd_rand rng(seed);
+		auto dag = path_dag(d, p1_i, p2_i, k, rng, bits.get());
+		if (!dag) return 0;
+
+		int len = dag->distance+1;
+		if (len>cap) throw runtime_error("path doesn't fit");
+
+		*out_n_paths = dag->n_paths;
+		copy(dag->width.begin(), dag->width.end(), out_width);
+		for (int i=0; i<k; i++) {
+			for (int j=0; j<len; j++) out_paths[i*cap+j]=d.to_id(dag->paths[i][j]);
+			copy(dag->choices[i].begin(), dag->choices[i].end(), out_choices+i*cap);
+		}
+
+		return len;
+	}, -1);
+}
+
+int32_t kiosk_graph_distances(kiosk_graph* graph, int64_t const* from, int32_t n, int64_t to, kiosk_banned* banned,
+	int32_t* out, kiosk_cancel* cancel) {
+	return kiosk_try([&]() -> int32_t {
+		auto ver = graph->cur.load();
+		Data d = ver->d;
+		auto bits = banned ? banned->for_version(ver) : nullptr;
+
+		fill(out, out+n, -2);
+		int target = d.from_id(to);
+		if (target==-1) return 1;
+
+		//pages that exist, and where they go in out
+		gtl::vector<int> sources, idx;
+		for (int i=0; i<n; i++) {
+			int x = d.from_id(from[i]);
+			if (x!=-1) sources.push_back(x), idx.push_back(i);
+		}
+
+		gtl::vector<int> dist;
+		if (!distances_to(d, sources, target, dist, cancel ? &cancel->set : nullptr, bits.get())) return 0;
+
+		for (int i=0; i<idx.size(); i++) out[idx[i]]=dist[i];
+		return 1;
+	}, -1);
+}
+
+int32_t kiosk_graph_select(kiosk_graph* graph, int32_t min_distance, kiosk_banned* banned, uint64_t seed, int64_t* out) {
+	return kiosk_try([&]() -> int32_t {
+		auto ver = graph->cur.load();
+		Data d = ver->d;
+		auto bits = banned ? banned->for_version(ver) : nullptr;
+
+		minstd_rand rng(seed);
+		auto res = select(d, min_distance, rng, bits.get());
+		if (!res) return 0;
+
+		out[0]=d.to_id(res->source);
+		out[1]=d.to_id(res->target);
+		out[2]=res->distance;
+		return 1;
+	}, -1);
+}
+
+kiosk_banned* kiosk_banned_new(int64_t const* ids, int32_t n) {
+	return kiosk_try([&]() {
+		auto out = new kiosk_banned;
+		out->ids.assign(ids, ids+n);
+		return out;
+	}, nullptr);
+}
+
+void kiosk_banned_free(kiosk_banned* banned) {
+	delete banned;
+}
+
+kiosk_store* kiosk_store_open(char const* path) {
+	return kiosk_try([&]() {return new kiosk_store(path);}, nullptr);
+}
+
+void kiosk_store_free(kiosk_store* store) {
+	delete store;
+}
+
+int32_t kiosk_store_page(kiosk_store* ks, int64_t id, char const* title, char* out, int32_t cap) {
+	return kiosk_try([&]() -> int32_t {
+		lock_guard lock(ks->m);
+		PageStore& store = ks->store;
+
+		int i = title ? store.find_title(title) : store.find_id(id);
+		if (i!=ks->last) {
+			auto page = store.get(i);
+			if (!page) return 0;
+
+			stringstream ss;
+			print_page_json(ss, store.id(i), *page);
+			ks->last=i, ks->last_json=ss.str();
+		}
+
+		string const& str = ks->last_json;
+		if (str.size()>INT32_MAX) throw runtime_error("page too big");
+		copy_n(str.begin(), min<size_t>(cap, str.size()), out);
+		return str.size();
+	}, -1);
+}
+
+kiosk_cancel* kiosk_cancel_new() {
+	return new kiosk_cancel;
+}
+
+void kiosk_cancel_set(kiosk_cancel* cancel) {
+	cancel->set=true;
+}
+
+void kiosk_cancel_free(kiosk_cancel* cancel) {
+	delete cancel;
+}
+
+}
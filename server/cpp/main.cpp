@@ -1,21 +1,40 @@
 #ifndef BUILD_DEBUG
 #include <mimalloc.h>
+//libkiosk is loaded into the server's process, which keeps its own operator new
+#ifndef KIOSK_LIB
 #include <mimalloc-new-delete.h>
 #endif
+#endif
 
 #include <algorithm>
 #include <sstream>
 #include <cassert>
+#include <cmath>
+#include <climits>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <queue>
 #include <random>
 #include <ranges>
 #include <stdexcept>
 #include <variant>
 #include <unordered_map>
 
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stats.hpp"
+
 using namespace std;
 
 #ifndef BUILD_DEBUG
@@ -54,10 +73,11 @@ constexpr static string print_cell_numbers[9] = {
 	" ", "1", "2", "3", "4", "5", "6", "7", "8"
 };
 
-using CellProbs = vec<float>;
+//# of mine assignments, indexed by # mines used
+using CellProbs = vec<double>;
 
 template<class F>
-void for_neighbors(int i, int j, int h, int w, F f) {
+constexpr void for_neighbors(int i, int j, int h, int w, F f) {
 	for (int di=-1; di<=1; di++) {
 		for (int dj=-1; dj<=1; dj++) {
 			//-_-
@@ -93,13 +113,86 @@ int adj_index(int x, int y, int w) {
 //ughhh
 int shift(int a, int b) {return b>0 ? a<<b : a>>(-b);}
 
-struct Solver {
+//a cell's neighbors inline, so walking them doesn't chase a pointer per cell
+struct Neighbors {
+	int n=0;
+	array<int,8> at {};
+
+	constexpr void push_back(int x) {at[n++]=x;}
+	int const* begin() const {return at.data();}
+	int const* end() const {return at.data()+n;}
+};
+
+//H x W boards are compiled for that size, so w, bounds and the neighbor table are constants
+//0x0 is the fallback for every other size, given at runtime
+template<int H, int W>
+struct BoardSize {
+	constexpr static int h=H, w=W, sz=H*W;
+	BoardSize(int, int) {}
+};
+
+template<>
+struct BoardSize<0,0> {
 	int h,w,sz;
+	BoardSize(int rows, int cols): h(rows), w(cols), sz(rows*cols) {}
+};
+
+template<int H, int W>
+constexpr array<Neighbors, H*W> neighbor_table() {
+	array<Neighbors, H*W> out {};
+	for (int i=0; i<H; i++) {
+		for (int j=0; j<W; j++) {
+			for_neighbors(i,j,H,W, [&](int ni, int nj) {
+				out[i*W + j].push_back(ni*W + nj);
+			});
+		}
+	}
+
+	return out;
+}
+
+template<int H, int W>
+struct NeighborTable {
+	constexpr static array<Neighbors, H*W> at = neighbor_table<H,W>();
+	NeighborTable(int, int) {}
+	Neighbors const& operator[](int x) const {return at[x];}
+};
+
+template<>
+struct NeighborTable<0,0> {
+	vec<Neighbors> at;
+
+	NeighborTable(int h, int w): at(h*w) {
+		for (int i=0; i<h; i++) {
+			for (int j=0; j<w; j++) {
+				for_neighbors(i,j,h,w, [&](int ni, int nj) {
+					at[i*w + j].push_back(ni*w + nj);
+				});
+			}
+		}
+	}
+
+	Neighbors const& operator[](int x) const {return at[x];}
+};
+
+//calls f with the BoardSize of the preset h x w is, or BoardSize<0,0>, to pick a Solver or Generator with:
+//with_board_size(h, w, [&]<int H, int W>(BoardSize<H,W>) {Generator<H,W> gen(h,w,...);})
+template<class F>
+auto with_board_size(int h, int w, F f) {
+	if (h==9 && w==9) return f(BoardSize<9,9>(h,w));
+	if (h==16 && w==16) return f(BoardSize<16,16>(h,w));
+	if (h==16 && w==30) return f(BoardSize<16,30>(h,w));
+	return f(BoardSize<0,0>(h,w));
+}
+
+template<int H=0, int W=0>
+struct Solver: BoardSize<H,W> {
+	using BoardSize<H,W>::h, BoardSize<H,W>::w, BoardSize<H,W>::sz;
 	int n_mine;
 
-	vec<vec<int>> neighbors;
+	NeighborTable<H,W> neighbors;
 
-	constexpr static float impossible = -numeric_limits<float>::infinity();
+	constexpr static double impossible = -numeric_limits<double>::infinity();
 
 	//bitmasks by length (0-8), # ones
 	array<array<vec<int>, 9>, 9> ways;
@@ -121,8 +214,27 @@ struct Solver {
 
 	struct CacheResult {
 		bool init;
-		CellProbs probs;
+		CellProbs probs {};
 		int known_i;
+
+		//deepest nesting of enumerations needed below this state, 0 if simple_solve is enough
+		//(elimination counts as one level, it stands in for enumerating)
+		int depth=0;
+
+		//flags after simple_solve (and elimination) and for each cell still undecided, probs given that it's a mine
+		State solved {};
+		vec<CellProbs> cell_probs {};
+
+		//flags after simple_solve alone, if elimination decided more. empty otherwise
+		State simple {};
+
+		CellProbs const* cell(int i) const {
+			switch (solved[i].flag()) {
+				case CellFlag::Mine: return &probs;
+				case CellFlag::Decide: return &cell_probs[i];
+				default: return nullptr;
+			}
+		}
 	};
 
 	vec<uint64_t> base;
@@ -132,22 +244,47 @@ struct Solver {
 	unordered_map<State, unique_ptr<CacheResult>, Hasher> cache;
 	#endif
 
+	//parts check splits a state into are keyed by canonical_key instead of by position, so the same part shifted,
+	//mirrored or turned hits too. off by default, building the keys costs more than it finds on the presets
+	bool canonical_keys=false;
+
+	using CanonKey = vec<uint64_t>;
+	struct CanonHasher {
+		uint64_t operator()(CanonKey const& k) const {
+			uint64_t out=k.size();
+			for (uint64_t x: k) out=(out^x)*0x100000001b3;
+			return out;
+		}
+	};
+
+	#ifndef BUILD_DEBUG
+	gtl::flat_hash_map<CanonKey, unique_ptr<CacheResult>, CanonHasher, std::equal_to<CanonKey>, mi_stl_allocator<pair<CanonKey,CacheResult>>> canon_cache;
+	#else
+	unordered_map<CanonKey, unique_ptr<CacheResult>, CanonHasher> canon_cache;
+	#endif
+
 	struct CheckState {
 		State s;
 		CacheResult* cache_it;
+		//empty if s is cached by position
+		CanonKey key;
 
-		CheckState(State s): s(s) {}
+		CheckState(State s, CanonKey canon_key={}): s(s), key(std::move(canon_key)) {}
 
 		int idx=0, count;
 
-		int n_ways=0;
 		int mine_offset=0;
 
 		variant<monostate, vec<State>,vec<int>> data;
+
+		//indices of each part's cells in s and their results once checked
+		vec<vec<int>> part_idx;
+		vec<CacheResult*> part_res;
 	};
 
 	vec<int> visited;
 	vec<int> tmp_cell_idx;
+	vec<int> tmp_cell_col;
 	vec<int> tmp_cell_msk;
 	vec<int> tmp_cell_count;
 
@@ -155,19 +292,14 @@ struct Solver {
 	vec<int> known_i;
 	int cur_known_i=0;
 
-	Solver(int h, int w, int n_mine): h(h), w(w), sz(h*w), n_mine(n_mine),
-		neighbors(sz),
-		cache(0,Hasher {.base=base}), visited(sz,-1),
-		tmp_cell_idx(sz,-1), tmp_cell_msk(sz,-1), tmp_cell_count(sz,-1),
-		known(sz,-1), known_i(sz,0) {
+	//states check looked up and found still valid in the cache / had to solve
+	size_t n_cache_hit=0, n_cache_miss=0;
 
-		for (int i=0; i<h; i++) {
-			for (int j=0; j<w; j++) {
-				for_neighbors(i,j,h,w, [&](int ni, int nj) {
-					neighbors[i*w + j].push_back(ni*w + nj);
-				});
-			}
-		}
+	Solver(int h, int w, int n_mine): BoardSize<H,W>(h,w), n_mine(n_mine),
+		neighbors(h,w),
+		cache(0,Hasher {.base=base}), visited(sz,-1),
+		tmp_cell_idx(sz,-1), tmp_cell_col(sz,-1), tmp_cell_msk(sz,-1), tmp_cell_count(sz,-1),
+		known(sz,-1), known_i(sz,0), state_idx(sz,-1), outside_idx(sz,-1) {
 
 		mt19937_64 rng(123); //i don't care lmao
 		for (int i=0; i<sz; i++) base.push_back(rng());
@@ -183,14 +315,43 @@ struct Solver {
 	vec<CheckState> cstates;
 	int visit_i=-1;
 
-	CellProbs* child_probs;
+	CacheResult* child;
 
 	void finish(CheckState const& cur) {
 		cur.cache_it->init=true;
-		child_probs = &cur.cache_it->probs;
+		child = cur.cache_it;
 		cstates.pop_back();
 	};
 
+	void add_shifted(CellProbs& to, CellProbs const& from, int offset) {
+		int max_n_mine = min(n_mine, offset + int(from.size()) - 1);
+		if (to.size()<=max_n_mine) to.resize(max_n_mine+1, impossible);
+
+		for (int i=offset; i<=max_n_mine; i++) {
+			double nv = from[i-offset];
+			if (isinf(nv)) continue;
+
+			if (isinf(to[i])) to[i]=nv;
+			else to[i]+=nv;
+		}
+	}
+
+	CellProbs combine(CellProbs const& a, CellProbs const& b) {
+		if (a.empty() || b.empty()) return {};
+
+		CellProbs out(min(int(a.size() + b.size()) - 1, n_mine+1), impossible);
+		for (int i=0; i<out.size(); i++) {
+			for (int j=max(0, i-int(b.size())+1); j<=min(i, int(a.size())-1); j++) {
+				if (isinf(a[j]) || isinf(b[i-j])) continue;
+
+				double nv = a[j] * b[i-j];
+				if (isinf(out[i])) out[i]=nv; else out[i]+=nv;
+			}
+		}
+
+		return out;
+	}
+
 	bool in_cell(CheckCell const& cell, int x) {
 		int adj1 = adj_index(cell.pos1, x, w);
 		if (adj1!=-1 && ((1<<adj1)&cell.msk1)) {
@@ -282,6 +443,9 @@ struct Solver {
 						}
 
 						if (tmp_cell_msk[y]) dfs.push_back(y);
+					} else {
+						//partial mask, don't let pairs below use it
+						tmp_cell_msk[y]=0;
 					}
 				}
 			}
@@ -320,6 +484,298 @@ struct Solver {
 		return true;
 	}
 
+	//integer elimination stops once a coefficient gets past this, what it has so far is still sound
+	constexpr static int max_coef = 1<<12;
+	//with fewer constraints than this left, enumerating them costs about as much as eliminating
+	constexpr static int min_elim_rows = 12;
+
+	//index in s of each column, rows of both eliminations
+	vec<int> elim_col;
+	vec<uint64_t> gf_rows;
+	vec<int> int_rows;
+	vec<int8_t> elim_val;
+
+	//between simple_solve and enumerating: the constraints simple_solve was left with (numbers in dfs, all of whose
+	//unknown neighbors are in s) reduced over GF(2) and over the integers, which can combine any number of them.
+	//a GF(2) row with one cell left gives it by parity, and an integer row whose total is the least or greatest
+	//its coefficients allow gives every cell in it. call right after simple_solve (for dfs and tmp_cell_*)
+	//returns whether it decided anything (see apply_eliminated), good becomes false if the constraints contradict
+	bool eliminate(bool& good) {
+		if (dfs.size()<min_elim_rows) return false;
+		STAT_COUNT("solver.eliminate", 1);
+
+		auto row_cells = [this](int x, auto f) {
+			for_in_cell([this,&f](int y) {f(tmp_cell_idx[y]);}, CheckCell {x, -1, tmp_cell_msk[x], 0, 0});
+		};
+
+		elim_col.clear();
+		for (int x: dfs) {
+			row_cells(x, [this](int ci) {
+				if (tmp_cell_col[ci]==-1) tmp_cell_col[ci]=elim_col.size(), elim_col.push_back(ci);
+			});
+		}
+
+		int m=dfs.size(), n=elim_col.size();
+		elim_val.assign(n, -1);
+
+		auto force = [this, &good](int c, int v) {
+			if (elim_val[c]!=-1 && elim_val[c]!=v) good=false;
+			elim_val[c]=v;
+		};
+
+		//GF(2), bit packed with the parity after the cells
+		int n_word = (n+64)/64;
+		gf_rows.assign(m*n_word, 0);
+		for (int r=0; r<m; r++) {
+			uint64_t* row = &gf_rows[r*n_word];
+			row_cells(dfs[r], [this,row](int ci) {
+				int c=tmp_cell_col[ci];
+				row[c/64] |= uint64_t(1)<<(c%64);
+			});
+
+			if (tmp_cell_count[dfs[r]]&1) row[n/64] |= uint64_t(1)<<(n%64);
+		}
+
+		for (int c=0, rank=0; c<n && rank<m; c++) {
+			uint64_t bit = uint64_t(1)<<(c%64);
+			int p=rank;
+			while (p<m && !(gf_rows[p*n_word+c/64]&bit)) p++;
+			if (p==m) continue;
+
+			swap_ranges(&gf_rows[p*n_word], &gf_rows[(p+1)*n_word], &gf_rows[rank*n_word]);
+			for (int r=0; r<m; r++) {
+				if (r==rank || !(gf_rows[r*n_word+c/64]&bit)) continue;
+				for (int k=c/64; k<n_word; k++) gf_rows[r*n_word+k]^=gf_rows[rank*n_word+k];
+			}
+
+			rank++;
+		}
+
+		for (int r=0; r<m; r++) {
+			uint64_t const* row = &gf_rows[r*n_word];
+			int parity = row[n/64]>>(n%64)&1;
+
+			int n_cell=0, last=-1;
+			for (int k=0; k<n_word; k++) {
+				uint64_t x = k==n/64 ? row[k]&((uint64_t(1)<<(n%64))-1) : row[k];
+				if (x) n_cell+=__builtin_popcountll(x), last=64*k+63-__builtin_clzll(x);
+			}
+
+			if (n_cell==0 && parity) good=false;
+			else if (n_cell==1) force(last, parity);
+		}
+
+		//integers, fraction free with the total in the last column
+		auto row = [this,n](int r) {return &int_rows[r*(n+1)];};
+		int_rows.assign(m*(n+1), 0);
+		for (int r=0; r<m; r++) {
+			row_cells(dfs[r], [this,r,&row](int ci) {row(r)[tmp_cell_col[ci]]=1;});
+			row(r)[n]=tmp_cell_count[dfs[r]];
+		}
+
+		bool small=true;
+		for (int c=0, rank=0; c<n && rank<m && small; c++) {
+			//the smallest pivot keeps coefficients down
+			int p=-1;
+			for (int r=rank; r<m; r++) {
+				if (row(r)[c] && (p==-1 || abs(row(r)[c])<abs(row(p)[c]))) p=r;
+			}
+
+			if (p==-1) continue;
+			swap_ranges(row(p), row(p)+n+1, row(rank));
+
+			int const* pr=row(rank);
+			for (int r=0; r<m; r++) {
+				int* rr=row(r);
+				int a=pr[c], e=rr[c];
+				if (r==rank || e==0) continue;
+
+				int g=0;
+				for (int j=0; j<=n; j++) {
+					rr[j] = a*rr[j] - e*pr[j];
+					g = gcd(g, abs(rr[j]));
+				}
+
+				if (g>1) for (int j=0; j<=n; j++) rr[j]/=g;
+				for (int j=0; j<=n; j++) if (abs(rr[j])>max_coef) small=false;
+			}
+
+			rank++;
+		}
+
+		for (int r=0; r<m; r++) {
+			int const* rr=row(r);
+			int lo=0, hi=0;
+			for (int j=0; j<n; j++) (rr[j]>0 ? hi : lo)+=rr[j];
+
+			if (rr[n]<lo || rr[n]>hi) good=false;
+			else if (lo==hi) continue;
+			else if (rr[n]==lo || rr[n]==hi) {
+				for (int j=0; j<n; j++) if (rr[j]) force(j, (rr[j]>0) == (rr[n]==hi));
+			}
+		}
+
+		bool found=false;
+		for (int c=0; c<n; c++) {
+			tmp_cell_col[elim_col[c]]=-1;
+			if (elim_val[c]!=-1) found=true;
+		}
+
+		if (found) STAT_COUNT("solver.eliminate.found", 1);
+		return found || !good;
+	}
+
+	//sets the cells eliminate decided in s
+	void apply_eliminated(State& s, int& mine_offset) {
+		for (int c=0; c<elim_col.size(); c++) {
+			if (elim_val[c]==-1) continue;
+			s[elim_col[c]] = elim_val[c] ? CellFlag::Mine : CellFlag::NoMine;
+			if (elim_val[c]) mine_offset++;
+		}
+	}
+
+	//split undecided cells of s into parts which don't share any known number
+	//tmp_cell_idx has to be set for s
+	void split(State const& s, vec<State>& parts, vec<vec<int>>& part_idx) {
+		int fst_visit_i=visit_i;
+
+		dfs.clear();
+		for (int ci=0; ci<s.size(); ci++) {
+			Cell c = s[ci];
+			if (c.flag()!=CellFlag::Decide || visited[c.position()]>fst_visit_i) continue;
+			auto& part = parts.emplace_back(1,c);
+			auto& idx = part_idx.emplace_back(1,ci);
+
+			dfs.push_back(c.position());
+			visited[c.position()]=++visit_i;
+
+			while (dfs.size()) {
+				int x = dfs.back();
+				dfs.pop_back();
+
+				for (int y: neighbors[x]) {
+					if (visited[y]!=visit_i) {
+						if (tmp_cell_idx[y]!=-1) {
+							Cell a = s[tmp_cell_idx[y]];
+							part.push_back(a);
+							idx.push_back(tmp_cell_idx[y]);
+							if (a.flag()==CellFlag::Decide) dfs.push_back(y);
+
+							visited[y]=visit_i;
+						} else if (known[x]==-1 && known[y]!=-1) {
+							dfs.push_back(y);
+
+							visited[y]=visit_i;
+						}
+					}
+				}
+			}
+
+			//position order, so parts hit the cache no matter how s is ordered
+			sort(idx.begin(), idx.end(), [&s](int a, int b) {
+				return s[a].position()<s[b].position();
+			});
+
+			for (int j=0; j<idx.size(); j++) part[j]=s[idx[j]];
+		}
+	}
+
+	vec<pair<int,int>> tmp_canon_elem;
+	vec<uint64_t> tmp_canon_code;
+	vec<int> tmp_canon_order, tmp_canon_best;
+
+	//the cells of part and the known numbers next to them, under whichever of the 8 symmetries of the grid sorts
+	//smallest and relative to the corner of their bounding box. numbers with unknown neighbors outside the part only
+	//join cells in split, so they're all marked 9. that's everything check reads of a part, so entries keyed by it
+	//never go stale. reorders part and idx to the key's order, so results line up with any part that has the same key
+	CanonKey canonical_key(State& part, vec<int>& idx) {
+		STAT_TIME("solver.canonical_key");
+
+		int in_part = ++visit_i;
+		for (Cell c: part) visited[c.position()]=in_part;
+
+		//position and tag: the flag for cells, 4+the number for numbers
+		auto& elem = tmp_canon_elem;
+		elem.clear();
+		for (Cell c: part) elem.push_back({c.position(), int(c.flag())});
+
+		int seen = ++visit_i;
+		for (Cell c: part) {
+			for (int y: neighbors[c.position()]) {
+				if (known[y]==-1 || visited[y]==seen) continue;
+				visited[y]=seen;
+
+				int v = known[y];
+				for (int z: neighbors[y]) if (known[z]==-1 && visited[z]!=in_part) {v=9; break;}
+				elem.push_back({y, 4+v});
+			}
+		}
+
+		auto& code = tmp_canon_code;
+		auto& order = tmp_canon_order;
+		auto& best = tmp_canon_best;
+		CanonKey key;
+
+		for (int t=0; t<8; t++) {
+			auto at = [this,t](int x) {
+				int i=x/w, j=x%w;
+				if (t&1) i=-i;
+				if (t&2) j=-j;
+				if (t&4) swap(i,j);
+				return pair{i,j};
+			};
+
+			int min_i=INT_MAX, min_j=INT_MAX;
+			for (auto [x,tag]: elem) {
+				auto [i,j] = at(x);
+				min_i=min(min_i,i), min_j=min(min_j,j);
+			}
+
+			code.clear();
+			for (auto [x,tag]: elem) {
+				auto [i,j] = at(x);
+				code.push_back(uint64_t(i-min_i)<<36 | uint64_t(j-min_j)<<8 | uint64_t(tag));
+			}
+
+			order.resize(elem.size());
+			iota(order.begin(), order.end(), 0);
+			sort(order.begin(), order.end(), [&code](int a, int b) {return code[a]<code[b];});
+
+			bool less = key.empty();
+			for (int e=0; e<order.size() && !less; e++) {
+				if (code[order[e]]!=key[e]) {
+					if (code[order[e]]>key[e]) break;
+					less=true;
+				}
+			}
+
+			if (!less) continue;
+			key.clear();
+			for (int e: order) key.push_back(code[e]);
+			best.assign(order.begin(), order.end());
+		}
+
+		State new_part;
+		vec<int> new_idx;
+		for (int e: best) {
+			if (e>=part.size()) continue;
+			new_part.push_back(part[e]);
+			new_idx.push_back(idx[e]);
+		}
+
+		part=std::move(new_part);
+		idx=std::move(new_idx);
+		return key;
+	}
+
+	//moves part pi of cur (from split) onto cstates to be checked
+	void push_part(CheckState& cur, int pi) {
+		State part = std::move(get<vec<State>>(cur.data)[pi]);
+		CanonKey key;
+		if (canonical_keys) key = canonical_key(part, cur.part_idx[pi]);
+		cstates.emplace_back(std::move(part), std::move(key));
+	}
+
 	void print_known_state(State const& s, CheckCell const* cell=nullptr) {
 		unordered_map<int,CellFlag> by_pos;
 		for (Cell c: s) by_pos.insert({c.position(), c.flag()});
@@ -342,7 +798,8 @@ struct Solver {
 
 	constexpr static bool dbg=false;
 	CellProbs check(State initial_state) {
-		if (dbg) cache.clear();
+		STAT_TIME("solver.check");
+		if (dbg) cache.clear(), canon_cache.clear();
 		cstates.push_back(CheckState(initial_state));
 
 		while (cstates.size()) {
@@ -354,26 +811,36 @@ struct Solver {
 					print_known_state(cur.s);
 				}
 
-				auto res = cache.find(cur.s);
-
-				if (res!=cache.end()) {
-					assert(res->second->init);
-
+				CacheResult* found=nullptr;
+				if (!cur.key.empty()) {
+					auto res = canon_cache.find(cur.key);
+					if (res!=canon_cache.end()) found=res->second.get();
+				} else if (auto res = cache.find(cur.s); res!=cache.end()) {
 					int max_known_i=0;
 					for (Cell& x: cur.s)
 						max_known_i=max(max_known_i, known_i[x.position()]);
 
-					if (max_known_i <= res->second->known_i) {
-						child_probs=&res->second->probs;
-						cstates.pop_back();
-						if (dbg) cout<<"found in cache\n";
-						continue;
-					}
+					if (max_known_i <= res->second->known_i) found=res->second.get();
+				}
+
+				if (found) {
+					assert(found->init);
+					child=found;
+					cstates.pop_back();
+					n_cache_hit++;
+					STAT_COUNT("solver.cache_hit", 1);
+					if (dbg) cout<<"found in cache\n";
+					continue;
 				}
 
-				cur.cache_it=cache.insert_or_assign(cur.s, make_unique<CacheResult>(CacheResult {
-					.init=false, .known_i=cur_known_i
-				})).first->second.get();
+				n_cache_miss++;
+				STAT_COUNT("solver.cache_miss", 1);
+
+				auto entry = make_unique<CacheResult>(CacheResult {.init=false, .known_i=cur_known_i});
+				cur.cache_it=entry.get();
+				if (!cur.key.empty()) canon_cache.emplace(std::move(cur.key), std::move(entry));
+				else cache.insert_or_assign(cur.s, std::move(entry));
+				STAT_MAX("solver.cache_size_max", cache.size()+canon_cache.size());
 				auto& ret = cur.cache_it->probs;
 
 				for (int ci=0; ci<cur.s.size(); ci++)
@@ -381,8 +848,26 @@ struct Solver {
 
 				CheckCell cell;
 				bool good = simple_solve(cur.s, cur.mine_offset, cell);
+
+				//enumerating is exponential, so eliminate first whenever simple_solve gets stuck
+				State simple;
+				while (good && cell.pos1!=-1 && eliminate(good)) {
+					if (!good) break;
+					if (simple.empty()) simple = cur.s;
+					apply_eliminated(cur.s, cur.mine_offset);
+					good = simple_solve(cur.s, cur.mine_offset, cell);
+				}
+
 				if (cur.mine_offset>n_mine) good=false;
 
+				cur.cache_it->solved = cur.s;
+				if (!simple.empty()) {
+					cur.cache_it->simple = std::move(simple);
+					cur.cache_it->depth = 1;
+				}
+
+				cur.cache_it->cell_probs.resize(cur.s.size());
+
 				if (!good || cell.pos1==-1) {
 					if (dbg) cout<<"it's "<<(good ? "good" : "bad")<<", returning\n";
 
@@ -397,39 +882,8 @@ struct Solver {
 					continue;
 				}
 
-				int fst_visit_i=visit_i;
-				auto& data = cur.data.emplace<vec<State>>();
-
-				dfs.clear();
-				for (int ci=0; ci<cur.s.size(); ci++) {
-					Cell c = cur.s[ci];
-					if (c.flag()!=CellFlag::Decide || visited[c.position()]>fst_visit_i) continue;
-					auto& part = data.emplace_back(1,c);
-
-					dfs.push_back(c.position());
-					visited[c.position()]=++visit_i;
-
-					while (dfs.size()) {
-						int x = dfs.back();
-						dfs.pop_back();
-
-						for (int y: neighbors[x]) {
-							if (visited[y]!=visit_i) {
-								if (tmp_cell_idx[y]!=-1) {
-									Cell a = cur.s[tmp_cell_idx[y]];
-									part.push_back(a);
-									if (a.flag()==CellFlag::Decide) dfs.push_back(y);
-
-									visited[y]=visit_i;
-								} else if (known[x]==-1 && known[y]!=-1) {
-									dfs.push_back(y);
-
-									visited[y]=visit_i;
-								}
-							}
-						}
-					}
-				}
+				auto& data = cur.data.template emplace<vec<State>>();
+				split(cur.s, data, cur.part_idx);
 
 				for (Cell c: cur.s) tmp_cell_idx[c.position()]=-1;
 
@@ -443,15 +897,16 @@ struct Solver {
 						}
 					}
 
-					ret.resize(cur.mine_offset+1);
+					ret.assign(cur.mine_offset+1, impossible);
 					ret.back()=1.0;
 
-					cstates.emplace_back(std::move(data.back()));
-					get<vec<State>>(cstates[cstates.size()-2].data).pop_back();
+					push_part(cur, 0);
 					continue;
 				}
 
-				auto& choose_idx = cur.data.emplace<vec<int>>();
+				cur.part_idx.clear();
+
+				auto& choose_idx = cur.data.template emplace<vec<int>>();
 				cur.count=cell.count;
 				for (int ci=0; ci<cur.s.size(); ci++) {
 					int x = cur.s[ci].position();
@@ -467,57 +922,66 @@ struct Solver {
 				}
 			} else if (cur.data.index()==1) {
 				auto& data = get<vec<State>>(cur.data);
-				auto& ret = cur.cache_it->probs;
+				auto& res = *cur.cache_it;
+
+				cur.part_res.push_back(child);
+				res.probs = combine(res.probs, child->probs);
+				res.depth = max(res.depth, child->depth);
 
 				bool bad=true;
+				for (double x: res.probs) if (!isinf(x)) {bad=false; break;}
 
-				vec<float> out(min(int(child_probs->size() + ret.size()) - 1, n_mine+1), impossible);
-				for (int i=0; i<out.size(); i++) {
-					for (int j=max(0, i-int(child_probs->size())+1); j<=min(i, int(ret.size())-1); j++) {
-						if (isinf(ret[j]) || isinf(child_probs->at(i - j)))
-							continue;
+				if (bad) {
+					finish(cur);
+					continue;
+				}
 
-						float nv = ret[j] * child_probs->at(i - j);
-						if (isinf(out[i])) out[i]=nv; else out[i]+=nv;
-						bad=false;
-					}
+				int np = cur.part_res.size();
+				if (np<data.size()) {
+					push_part(cur, np);
+					continue;
 				}
 
-				ret=std::move(out);
-				if (data.empty() || bad) {
-					finish(cur);
-				} else {
-					auto& child = data.back();
-					cstates.emplace_back(std::move(child));
+				//with every part, given cell is a mine = (its part given the cell) * (other parts)
+				vec<CellProbs> suffix(np+1);
+				suffix[np] = {1.0};
+				for (int pi=np-1; pi>=0; pi--) suffix[pi] = combine(cur.part_res[pi]->probs, suffix[pi+1]);
+
+				CellProbs prefix(cur.mine_offset+1, impossible);
+				prefix.back()=1.0;
+
+				for (int pi=0; pi<np; pi++) {
+					auto other = combine(prefix, suffix[pi+1]);
+					auto const& idx = cur.part_idx[pi];
+
+					for (int j=0; j<idx.size(); j++) {
+						if (cur.s[idx[j]].flag()!=CellFlag::Decide) continue;
+						if (auto p = cur.part_res[pi]->cell(j))
+							res.cell_probs[idx[j]] = combine(other, *p);
+					}
 
-					data.pop_back();
+					prefix = combine(prefix, cur.part_res[pi]->probs);
 				}
+
+				finish(cur);
 			} else {
 				auto const& data = get<vec<int>>(cur.data);
-				auto& ret = cur.cache_it->probs;
+				auto& res = *cur.cache_it;
 
 				if (cur.idx>0) {
-					cur.n_ways++;
-
 					int n_mine_add = cur.mine_offset + cur.count;
-					int max_n_mine = min(n_mine, n_mine_add + int(child_probs->size()) - 1);
-					if (ret.size()<=max_n_mine) ret.resize(max_n_mine+1, impossible);
-
-					for (int i=n_mine_add; i<=max_n_mine; i++) {
-						float nv = child_probs->at(i-n_mine_add);
-						if (isinf(nv)) continue;
+					add_shifted(res.probs, child->probs, n_mine_add);
+					res.depth = max(res.depth, child->depth+1);
 
-						if (isinf(ret[i])) ret[i]=nv;
-						else ret[i]+=nv;
+					for (int ci=0; ci<cur.s.size(); ci++) {
+						if (cur.s[ci].flag()!=CellFlag::Decide) continue;
+						if (auto p = child->cell(ci))
+							add_shifted(res.cell_probs[ci], *p, n_mine_add);
 					}
 				}
 
 				auto const& ways_ref = ways[data.size()][cur.count];
 				if (cur.idx==ways_ref.size()) {
-					if (cur.n_ways>0) {
-						for (float& x: ret) x/=float(cur.n_ways);
-					}
-
 					finish(cur);
 					continue;
 				}
@@ -532,7 +996,7 @@ struct Solver {
 			}
 		}
 
-		return *child_probs;
+		return child->probs;
 	}
 
 	enum class Failure {
@@ -540,22 +1004,39 @@ struct Solver {
 	};
 
 	vec<Cell> state;
+	vec<int> state_idx;
 	int n_empty, n_outside;
 	int outside_perimeter;
-		
+
+	//unknown cells not on the perimeter
+	vec<int> outside;
+	vec<int> outside_idx;
+
+	//how far a change to x reaches into cached results
+	//checks of the whole perimeter only depend on numbers next to their cells, windows also on the cells past them
+	int touch_r=1;
+
+	void touch(int x) {
+		int i=x/w, j=x%w;
+		for (int a=max(0,i-touch_r); a<=min(h-1,i+touch_r); a++)
+			for (int b=max(0,j-touch_r); b<=min(w-1,j+touch_r); b++)
+				known_i[a*w+b]=cur_known_i;
+	}
+
 	void set_known(vec<int> const& new_known) {
 		cur_known_i++;
 
 		for (int i=0; i<sz; i++) {
 			if (known[i]!=new_known[i]) {
-				known_i[i]=cur_known_i;
-				for (int y: neighbors[i]) known_i[y]=cur_known_i;
-
+				touch(i);
 				known[i]=new_known[i];
 			}
 		}
 
+		for (Cell c: state) state_idx[c.position()]=-1;
+		for (int x: outside) outside_idx[x]=-1;
 		state.clear();
+		outside.clear();
 
 		n_empty=n_outside=0;
 		outside_perimeter=-1;
@@ -576,7 +1057,10 @@ struct Solver {
 				for (int y: neighbors[x]) {
 					if (visited[y]!=visit_i) {
 						if (known[y]!=-1) dfs.push_back(y);
-						else state.push_back(Cell(CellFlag::Decide, y));
+						else {
+							state_idx[y]=state.size();
+							state.push_back(Cell(CellFlag::Decide, y));
+						}
 
 						visited[y]=visit_i;
 					}
@@ -586,17 +1070,115 @@ struct Solver {
 
 		for (int i=0; i<sz; i++) {
 			if (known[i]==-1 && visited[i]!=visit_i) {
-				outside_perimeter=i, n_outside++;
+				outside_idx[i]=outside.size();
+				outside.push_back(i);
 			}
 		}
+
+		n_outside=outside.size();
+		outside_perimeter = outside.empty() ? -1 : outside.back();
 	}
 
-	bool can_be_mine(int pos) {
-		Cell* x = nullptr;
-		for (Cell& c: state) {
-			if (c.position()==pos) {x=&c; break;}
+	void remove_state(int x) {
+		int i = state_idx[x];
+		state[i]=state.back();
+		state_idx[state[i].position()]=i;
+		state.pop_back();
+		state_idx[x]=-1;
+	}
+
+	void remove_outside(int x) {
+		int i = outside_idx[x];
+		outside[i]=outside.back();
+		outside_idx[outside[i]]=i;
+		outside.pop_back();
+		outside_idx[x]=-1;
+	}
+
+	//put x in state or outside depending on whether it's unknown and next to a known cell
+	void classify(int x) {
+		bool front=false;
+		if (known[x]==-1) {
+			for (int y: neighbors[x]) if (known[y]!=-1) {front=true; break;}
+		}
+
+		bool out = known[x]==-1 && !front;
+
+		if (state_idx[x]!=-1 && !front) remove_state(x);
+		if (outside_idx[x]!=-1 && !out) remove_outside(x);
+
+		if (front && state_idx[x]==-1) {
+			state_idx[x]=state.size();
+			state.push_back(Cell(CellFlag::Decide, x));
+		} else if (out && outside_idx[x]==-1) {
+			outside_idx[x]=outside.size();
+			outside.push_back(x);
+		}
+	}
+
+	//like set_known, but only for cells that changed (revealed or hidden again)
+	//only touches their neighborhoods instead of the whole board
+	void update_known(vec<int> const& cells, vec<int> const& new_known) {
+		cur_known_i++;
+
+		for (int x: cells) {
+			touch(x);
+
+			if (known[x]==-1 && new_known[x]!=-1) n_empty--;
+			else if (known[x]!=-1 && new_known[x]==-1) n_empty++;
+
+			known[x]=new_known[x];
+		}
+
+		for (int x: cells) {
+			classify(x);
+			for (int y: neighbors[x]) classify(y);
+		}
+
+		n_outside=outside.size();
+		outside_perimeter = outside.empty() ? -1 : outside.back();
+	}
+
+	vec<char> can_mine;
+	bool outside_can_mine;
+	//result of the last mine_possible for the whole perimeter
+	CacheResult* root;
+
+	//fills can_mine for every cell in state and outside_can_mine for cells off the perimeter with a single check
+	//returns false if there's no valid assignment at all
+	bool mine_possible() {
+		can_mine.assign(state.size(), 0);
+		outside_can_mine=false;
+
+		//bounds on # mines in the perimeter
+		int lo = max(0, n_mine-n_outside), hi = n_mine;
+		auto any_in = [](CellProbs const& v, int a, int b) {
+			for (int i=max(a,0); i<=b && i<v.size(); i++) if (!isinf(v[i])) return true;
+			return false;
+		};
+
+		auto probs = check(state);
+		root = child;
+		if (!any_in(probs, lo, hi)) return false;
+		outside_can_mine = n_outside>0 && any_in(probs, lo, hi-1);
+
+		for (int ci=0; ci<state.size(); ci++) {
+			auto p = root->cell(ci);
+			can_mine[ci] = p && any_in(*p, lo, hi);
 		}
 
+		return true;
+	}
+
+	//whether the cell at state index ci is safe by simple_solve alone, without eliminating, enumerating or counting mines
+	bool trivially_safe(int ci) {
+		State const& s = root->simple.empty() ? root->solved : root->simple;
+		return s[ci].flag()==CellFlag::NoMine;
+	}
+
+	bool can_be_mine(int pos) {
+		Cell* x = state_idx[pos]==-1 ? nullptr : &state[state_idx[pos]];
+
 		bool ret=false;
 		if (x) (*x)=CellFlag::Mine;
 
@@ -610,63 +1192,175 @@ struct Solver {
 		return ret;
 	}
 
+	//for boards too big to check the whole perimeter at once
+	//only uses numbers whose unknown neighbors are all within r of pos and ignores the total # of mines
+	//so it's weaker than can_be_mine, but anything it finds safe is safe. needs touch_r=2
+	constexpr static int max_local_cache = 1<<18;
+
+	bool local_can_be_mine(int pos, int r) {
+		STAT_COUNT("solver.local_check", 1);
+		if (state_idx[pos]==-1) return true;
+		if (cache.size()+canon_cache.size()>max_local_cache) cache.clear(), canon_cache.clear();
+
+		State s;
+		int i=pos/w, j=pos%w;
+		for (int a=max(0,i-r); a<=min(h-1,i+r); a++) {
+			for (int b=max(0,j-r); b<=min(w-1,j+r); b++) {
+				int y=a*w+b;
+				if (state_idx[y]!=-1) s.push_back(Cell(y==pos ? CellFlag::Mine : CellFlag::Decide, y));
+			}
+		}
+
+		for (double x: check(s)) if (!isinf(x)) return true;
+		return false;
+	}
+
 	variant<Failure, array<int,2>> solve() {
 		set_known(known);
 
 		if (n_empty==sz) return Failure::Empty;
 		if (n_mine>=n_empty || state.empty()) return Failure::Solved;
 
-		int min_on_perimeter = max(0, n_mine - n_outside);
-
-		auto on_perimeter = check(state);
-		bool possible=false;
-		for (int i=min_on_perimeter; i<n_mine && i<on_perimeter.size(); i++) {
-			if (!isinf(on_perimeter[i])) {
-				possible=true; break;
-			}
-		}
-
-		if (!possible && (on_perimeter.size()<=n_mine || isinf(on_perimeter[n_mine])))
-			return Failure::Unsolvable;
+		if (!mine_possible()) return Failure::Unsolvable;
 
 		int out=-1;
-		if (!possible && outside_perimeter!=-1) {
+		if (!outside_can_mine && outside_perimeter!=-1) {
 			out=outside_perimeter;
 		} else for (int i=0; i<state.size(); i++) {
-			state[i]=CellFlag::Mine;
-
-			auto res = check(state);
-
-			possible=false;
-			for (int j=max(0,min_on_perimeter-1); j<=min(int(res.size())-1, n_mine-1); j++) {
-				if (!isinf(res[j])) {possible=true; break;}
-			}
-
-			if (!possible) {
+			if (!can_mine[i]) {
 				out=state[i].position();
-				// cout<<perimeter[i]/w<<", "<<perimeter[i]%w<<" clear\n";
 				break;
 			}
-
-			state[i]=CellFlag::Decide;
 		}
 
 		if (out==-1) return Failure::MustGuess;
 		return array<int,2>{out/w, out%w};
 	}
-};
 
-struct Generator {
-	int w,h,n_mine;
-	vec<bool> g;
+	struct Hint {
+		vec<int> safe, mine;
+		//probability each cell is a mine, 0 for known cells
+		vec<double> prob;
+	};
 
-	array<vec<int>,6> class_pos;
+	//everything provable about the current known board plus exact mine probabilities
+	//call update_known with the cells that changed first; the cache carries over between calls
+	variant<Failure, Hint> hint() {
+		STAT_TIME("solver.hint");
+		if (!mine_possible()) return Failure::Unsolvable;
+
+		int lo = max(0, n_mine-n_outside), hi = n_mine;
+		CellProbs const& probs = root->probs;
+
+		//relative weight of each # mines in the perimeter, counting placements of the rest outside
+		vec<double> weight(hi+1, 0.0);
+		double max_lw = -numeric_limits<double>::infinity();
+		for (int k=lo; k<=hi && k<probs.size(); k++) {
+			if (isinf(probs[k])) continue;
+			weight[k] = log(probs[k]) + lgamma(n_outside+1)
+				- lgamma(n_mine-k+1) - lgamma(n_outside-(n_mine-k)+1);
+			max_lw = max(max_lw, weight[k]);
+		}
+
+		double total=0;
+		for (int k=lo; k<=hi && k<probs.size(); k++) {
+			weight[k] = isinf(probs[k]) ? 0 : exp(weight[k]-max_lw);
+			total+=weight[k];
+		}
+
+		Hint out {.safe={}, .mine={}, .prob=vec<double>(sz, 0.0)};
+
+		for (int ci=0; ci<state.size(); ci++) {
+			int x = state[ci].position();
+			if (!can_mine[ci]) {
+				out.safe.push_back(x);
+				continue;
+			}
+
+			auto p = root->cell(ci);
+			bool always=true;
+			double px=0;
+			for (int k=lo; k<=hi && k<probs.size(); k++) {
+				if (weight[k]==0) continue;
+
+				double c = k<p->size() ? (*p)[k] : impossible;
+				if (isinf(c)) {always=false; continue;}
+				if (c<probs[k]*(1-1e-9)) always=false;
+
+				px += weight[k]*c/probs[k];
+			}
+
+			out.prob[x] = always ? 1.0 : px/total;
+			if (always) out.mine.push_back(x);
+		}
+
+		if (n_outside>0) {
+			bool always=true;
+			double px=0;
+			for (int k=lo; k<=hi && k<probs.size(); k++) {
+				if (weight[k]==0) continue;
+				if (n_mine-k<n_outside) always=false;
+				px += weight[k]*(n_mine-k)/n_outside;
+			}
+
+			for (int x: outside) {
+				out.prob[x] = always ? 1.0 : px/total;
+				if (!outside_can_mine) out.safe.push_back(x);
+				else if (always) out.mine.push_back(x);
+			}
+		}
+
+		return out;
+	}
+};
+
+struct Difficulty {
+	//# of moves which need more than simple_solve (enumeration or counting mines)
+	int min_deductions=0, max_deductions=INT_MAX;
+	//deepest enumeration any move can need
+	int max_depth=INT_MAX;
+	int min_3bv=0, max_3bv=INT_MAX;
+};
+
+struct Metrics {
+	int deductions, depth, bbbv;
+};
+
+void print_mine_pos(ostream& os, int h, int w, vec<bool> const& g) {
+	for (int i=0; i<h; i++) {
+		for (int j=0; j<w; j++) {
+			int x = i*w+j;
+			if (g[x]) os<<i<<","<<j<<"\n";
+		}
+	}
+
+	os.flush();
+}
+
+//h*w bits row-major, least significant bit first, written in one go
+void print_mine_bits(ostream& os, int h, int w, vec<bool> const& g) {
+	string buf((h*w+7)/8, '\0');
+	for (int x=0; x<h*w; x++) if (g[x]) buf[x/8] |= char(1<<(x%8));
+	os.write(buf.data(), buf.size());
+	os.flush();
+}
+
+template<int H=0, int W=0>
+struct Generator: BoardSize<H,W> {
+	using BoardSize<H,W>::h, BoardSize<H,W>::w;
+	int n_mine;
+	vec<bool> g;
+
+	array<vec<int>,6> class_pos;
 
 	mt19937_64 rng;
 
+	//positions flipped since the checkpoint, the first n_refreshed are reflected in known
 	vec<int> flip;
+	int n_refreshed;
 
 	bool shift(int k, array<int,4> bbox) {
+		STAT_COUNT("generator.shift", 1);
 		for (int i=0; i<6; i++) class_pos[i].clear();
 
 		for (int r=bbox[0]; r<=bbox[1]; r++) {
@@ -695,6 +1389,7 @@ struct Generator {
 				int j = uniform_int_distribution<>(0,class_pos[b].size()-1)(rng);
 				for (int x: {class_pos[a][i], class_pos[b][j]}) {
 					g[x]=!g[x];
+					flip.push_back(x);
 				}
 				swap(class_pos[a][i], class_pos[b][j]);
 				r=true;
@@ -718,6 +1413,25 @@ struct Generator {
 	}
 
 	vec<int> known;
+	//cells revealed/hidden since the solver was last synced
+	vec<int> changed;
+
+	//cells in the order they were revealed
+	//level 0 is the start and level i+1 is move_stack[i], level_begin is where each starts in trail
+	vec<int> trail;
+	vec<int> level_begin;
+	vec<int> level;
+
+	vec<array<int,2>> move_stack;
+
+	Difficulty diff;
+	//for each move, whether it was a non-trivial deduction and its enumeration depth
+	vec<char> move_hard;
+	vec<int> move_depth;
+	int n_hard;
+
+	Metrics metrics;
+
 	int reveal(int i, int j) {
 		if (g[i*w+j]) throw runtime_error("its a mine oh fuck");
 		if (known[i*w+j]!=-1) throw runtime_error("already known");
@@ -728,6 +1442,10 @@ struct Generator {
 		while (dfs.size()) {
 			auto [u,v] = dfs.back(); dfs.pop_back();
 
+			trail.push_back(u*w+v);
+			changed.push_back(u*w+v);
+			level[u*w+v]=level_begin.size()-1;
+
 			int& n_adj_mine=known[u*w+v]=0;
 			for_neighbors(u,v,h,w, [&](int ni, int nj) {
 				if (g[ni*w+nj]) n_adj_mine++;
@@ -758,21 +1476,19 @@ struct Generator {
 		}
 	}
 
+	//boards bigger than this only check a window around each move, see Solver::local_can_be_mine
+	constexpr static int local_area = 50*50;
+	constexpr static int local_r = 3;
+	constexpr static int local_endgame = 64;
+	bool local;
+
 	int start_i,start_j,start;
-	Generator(int w, int h, int start_i, int start_j, int n_mine, int seed):
-		w(w), h(h), n_mine(n_mine), g(h*w), rng(seed), start_i(start_i), start_j(start_j), start(start_i*w + start_j) {
+	Generator(int h, int w, int start_i, int start_j, int n_mine, uint64_t seed, Difficulty difficulty={}):
+		BoardSize<H,W>(h,w), n_mine(n_mine), g(h*w), rng(seed), known(h*w,-1), level(h*w), diff(difficulty),
+		local(h*w>local_area), start_i(start_i), start_j(start_j), start(start_i*w + start_j) {
 		gen_initial();
 	}
 
-	void print_mine_pos(ostream& os) {
-		for (int i=0; i<h; i++) {
-			for (int j=0; j<w; j++) {
-				int x = i*w+j;
-				if (g[x]) os<<i<<","<<j<<endl;
-			}
-		}
-	}
-
 	void print(ostream& os) {
 		for (int i=0; i<h; i++) {
 			for (int j=0; j<w; j++) {
@@ -784,9 +1500,449 @@ struct Generator {
 		}
 	}
 
+	//hide everything revealed at level l and after
+	void backtrack(int l) {
+		if (l>=level_begin.size()) return;
+
+		while (trail.size()>level_begin[l]) {
+			known[trail.back()]=-1;
+			changed.push_back(trail.back());
+			trail.pop_back();
+		}
+
+		level_begin.resize(l);
+	}
+
+	//reveal start/moves from level l on, stops and returns false at a move which is a mine
+	bool replay(int l) {
+		for (; l<=move_stack.size(); l++) {
+			auto [i,j] = l==0 ? array<int,2>{start_i,start_j} : move_stack[l-1];
+			if (g[i*w+j]) return false;
+
+			level_begin.push_back(trail.size());
+			if (known[i*w+j]==-1) reveal(i,j);
+		}
+
+		return true;
+	}
+
+	void reset() {
+		known.assign(h*w,-1);
+		trail.clear();
+		level_begin.clear();
+		changed.clear();
+		replay(0);
+	}
+
+	//lowest level recomputed since the checkpoint
+	int dirty_level;
+
+	void checkpoint() {
+		flip.clear();
+		n_refreshed=0;
+		dirty_level=level_begin.size();
+	}
+
+	//recompute known after flips, starting at the first level that reveals one of them or a neighbor
+	//returns false if a move is now a mine
+	bool refresh() {
+		int l=level_begin.size();
+		for (; n_refreshed<flip.size(); n_refreshed++) {
+			int x = flip[n_refreshed];
+			if (known[x]!=-1) l=min(l, level[x]);
+
+			for_neighbors(x/w, x%w, h, w, [&](int ni, int nj) {
+				if (known[ni*w+nj]!=-1) l=min(l, level[ni*w+nj]);
+			});
+		}
+
+		dirty_level=min(dirty_level, l);
+		backtrack(l);
+		return replay(l);
+	}
+
+	void rollback() {
+		STAT_COUNT("generator.rollback", 1);
+		while (flip.size()) {
+			g[flip.back()]=!g[flip.back()];
+			flip.pop_back();
+		}
+
+		backtrack(dirty_level);
+		replay(dirty_level);
+	}
+
+	void sync(Solver<H,W>& s) {
+		s.update_known(changed, known);
+		changed.clear();
+	}
+
+	//# of clicks to clear the board without flags: one per opening and one per number not next to an opening
+	int bbbv() {
+		vec<int> num(h*w,0);
+		for (int x=0; x<h*w; x++) {
+			for_neighbors(x/w, x%w, h, w, [&](int ni, int nj) {
+				num[x]+=g[ni*w+nj];
+			});
+		}
+
+		vec<char> vis(h*w,0);
+		vec<int> dfs;
+		int out=0;
+		for (int x=0; x<h*w; x++) {
+			if (g[x] || num[x] || vis[x]) continue;
+
+			out++;
+			dfs={x};
+			vis[x]=1;
+			while (dfs.size()) {
+				int y=dfs.back(); dfs.pop_back();
+				if (num[y]) continue;
+
+				for_neighbors(y/w, y%w, h, w, [&](int ni, int nj) {
+					if (!vis[ni*w+nj]) {
+						vis[ni*w+nj]=1;
+						dfs.push_back(ni*w+nj);
+					}
+				});
+			}
+		}
+
+		for (int x=0; x<h*w; x++) if (!g[x] && !vis[x]) out++;
+		return out;
+	}
+
+	int miss(Metrics const& m) {
+		return max(0, diff.min_deductions-m.deductions) + max(0, m.deductions-diff.max_deductions)
+			+ max(0, m.depth-diff.max_depth)
+			+ max(0, diff.min_3bv-m.bbbv) + max(0, m.bbbv-diff.max_3bv);
+	}
+
+	//closest finished board so far, if none were within the difficulty
+	int best_miss=INT_MAX;
+	vec<bool> best_g;
+	Metrics best_metrics;
+
+	bool accept() {
+		STAT_COUNT("generator.accept", 1);
+		metrics = {.deductions=n_hard, .depth=0, .bbbv=bbbv()};
+		for (int d: move_depth) metrics.depth=max(metrics.depth, d);
+
+		int m = miss(metrics);
+		if (m<best_miss) {
+			best_miss=m;
+			best_g=g;
+			best_metrics=metrics;
+		}
+
+		return m==0;
+	}
+
+	//like generate, but each check only looks at a window of the board (see Solver::local_can_be_mine)
+	//so after a shift, instead of replaying every later move, only levels whose move could have seen a changed cell are rechecked
+	//those that fail are undone. the remaining levels in order, then the new ones, are still a valid solve
+	//since knowing more never breaks a deduction. difficulty isn't steered, a board outside it is regenerated
+	//up to local_tries times and the closest kept, like generate
+	constexpr static int local_tries = 10;
+	bool generate_local() {
+		for (int t=0; t<local_tries; t++) {
+			if (t>0) {
+				gen_initial();
+				known.assign(h*w,-1);
+				changed.clear();
+				move_hard.clear();
+				move_depth.clear();
+			}
+
+			if (solve_local() && accept()) return true;
+		}
+
+		if (best_miss==INT_MAX) return false;
+
+		g=best_g;
+		metrics=best_metrics;
+		return true;
+	}
+
+	//one try of generate_local on the current mines, false if it gets stuck
+	bool solve_local() {
+		Solver<H,W> s(h,w,n_mine);
+		s.touch_r=2;
+
+		//a level's move can only depend on cells this close to it
+		constexpr int reach = local_r+2;
+
+		//for each level: the cell clicked, cells it revealed and whether it's still valid
+		vec<int> level_pos;
+		vec<vec<int>> level_cells;
+		vec<char> alive;
+		int n_revealed=0;
+
+		//undo log since the last try: (cell, known, level) before each change, killed levels
+		vec<array<int,3>> log;
+		vec<int> killed;
+
+		vec<int> pending;
+		vec<char> is_pending(h*w,0);
+
+		auto push_near = [&](int x) {
+			int i=x/w, j=x%w;
+			for (int a=max(0,i-local_r); a<=min(h-1,i+local_r); a++) {
+				for (int b=max(0,j-local_r); b<=min(w-1,j+local_r); b++) {
+					int y=a*w+b;
+					if (known[y]==-1 && !is_pending[y]) {
+						is_pending[y]=1;
+						pending.push_back(y);
+					}
+				}
+			}
+		};
+
+		auto sync_local = [&]() {
+			for (int x: changed) push_near(x);
+			sync(s);
+		};
+
+		auto set = [&](int x, int v, int l) {
+			log.push_back({x, known[x], level[x]});
+			n_revealed += (v!=-1) - (known[x]!=-1);
+			known[x]=v, level[x]=l;
+			changed.push_back(x);
+		};
+
+		auto number = [&](int x) {
+			int out=0;
+			for_neighbors(x/w, x%w, h, w, [&](int ni, int nj) {out+=g[ni*w+nj];});
+			return out;
+		};
+
+		auto open = [&](int x, int depth) {
+			int l = level_pos.size();
+			level_pos.push_back(x);
+			level_cells.emplace_back();
+			alive.push_back(1);
+			move_hard.push_back(depth>0);
+			move_depth.push_back(depth);
+
+			vec<int> dfs={x};
+			set(x, number(x), l);
+			while (dfs.size()) {
+				int y = dfs.back(); dfs.pop_back();
+				level_cells[l].push_back(y);
+				if (known[y]!=0) continue;
+
+				for (int z: s.neighbors[y]) if (known[z]==-1) {
+					set(z, number(z), l);
+					dfs.push_back(z);
+				}
+			}
+		};
+
+		//hide level l, later levels whose move was near something it revealed have to be rechecked
+		vec<array<int,2>> seeds;
+		auto kill = [&](int l) {
+			alive[l]=0;
+			killed.push_back(l);
+
+			for (int y: level_cells[l]) {
+				if (level[y]!=l || known[y]==-1) continue;
+				seeds.push_back({y,l});
+				set(y, -1, -1);
+			}
+		};
+
+		//whether level l's move is still safe knowing only what was revealed before it
+		vec<int> hide;
+		auto still_safe = [&](int l) {
+			int x=level_pos[l];
+			if (g[x]) return false;
+
+			hide.clear();
+			int i=x/w, j=x%w;
+			for (int a=max(0,i-reach); a<=min(h-1,i+reach); a++) {
+				for (int b=max(0,j-reach); b<=min(w-1,j+reach); b++) {
+					int y=a*w+b;
+					if (known[y]!=-1 && level[y]>=l) hide.push_back(y);
+				}
+			}
+
+			vec<int> vals;
+			for (int y: hide) vals.push_back(known[y]), known[y]=-1;
+			s.update_known(hide, known);
+
+			bool safe = !s.local_can_be_mine(x, local_r);
+
+			for (int k=0; k<hide.size(); k++) known[hide[k]]=vals[k];
+			s.update_known(hide, known);
+			return safe;
+		};
+
+		//recheck levels in order, since killing one can only affect those after it
+		priority_queue<int, vec<int>, greater<int>> recheck;
+		auto invalidate = [&]() {
+			while (seeds.size() || recheck.size()) {
+				while (seeds.size()) {
+					auto [x,lx] = seeds.back(); seeds.pop_back();
+
+					int i=x/w, j=x%w;
+					for (int a=max(0,i-reach); a<=min(h-1,i+reach); a++) {
+						for (int b=max(0,j-reach); b<=min(w-1,j+reach); b++) {
+							int y=a*w+b;
+							if (known[y]==-1) continue;
+
+							int l=level[y];
+							if (l>lx && alive[l] && level_pos[l]==y) recheck.push(l);
+						}
+					}
+				}
+
+				if (recheck.empty()) break;
+				int l=recheck.top();
+				while (recheck.size() && recheck.top()==l) recheck.pop();
+
+				if (!alive[l]) continue;
+				STAT_COUNT("generator.local_recheck", 1);
+				if (!still_safe(l)) kill(l);
+			}
+		};
+
+		int start_level=0;
+		auto deduce = [&]() {
+			if (!alive[start_level]) {
+				start_level=level_pos.size();
+				open(start, 0);
+				sync_local();
+			}
+
+			while (true) {
+				while (pending.size()) {
+					int x = pending.back(); pending.pop_back();
+					is_pending[x]=0;
+
+					if (known[x]!=-1 || g[x] || s.local_can_be_mine(x, local_r)) continue;
+
+					open(x, s.child->depth);
+					sync_local();
+				}
+
+				//the window ignores the # of mines, which only matters once few cells are left
+				if (h*w-n_revealed>local_endgame || !s.mine_possible()) break;
+
+				vec<int> safe;
+				for (int ci=0; ci<s.state.size(); ci++)
+					if (!s.can_mine[ci]) safe.push_back(s.state[ci].position());
+				if (!s.outside_can_mine) safe.insert(safe.end(), s.outside.begin(), s.outside.end());
+
+				int depth=s.root->depth;
+				for (int x: safe) if (known[x]==-1 && !g[x]) open(x, depth);
+				if (changed.empty()) break;
+				sync_local();
+			}
+		};
+
+		open(start, 0);
+		s.set_known(known);
+		changed.clear();
+		for (Cell c: s.state) push_near(c.position());
+
+		int size = min({h,w,5});
+		for (int iter=0; iter<max(1000,h*w); iter++) {
+			deduce();
+			if (n_revealed==h*w-n_mine) {
+				vec<int> depth;
+				for (int l=0; l<level_pos.size(); l++)
+					if (alive[l] && l!=start_level) depth.push_back(move_depth[l]);
+
+				move_depth=depth;
+				n_hard=0;
+				for (int d: depth) n_hard+=d>0;
+				return true;
+			}
+
+			if (s.state.empty()) return false;
+
+			//stuck, shift mines around a safe cell on the perimeter
+			int c=-1;
+			for (int t=0; t<10 && (c==-1 || g[c]); t++)
+				c = s.state[uniform_int_distribution<>(0,s.state.size()-1)(rng)].position();
+
+			int r1=clamp(c/w-size/2, 0, h-size), r2=r1+size-1;
+			int c1=clamp(c%w-size/2, 0, w-size), c2=c1+size-1;
+
+			for (int ti=0; ti<25; ti++) {
+				int n_before=n_revealed, n_levels=level_pos.size(), old_start=start_level;
+				log.clear();
+				killed.clear();
+				flip.clear();
+
+				if (!shift(2, {r1,r2,c1,c2})) continue;
+
+				for (int x: flip) {
+					if (known[x]!=-1 && alive[level[x]]) kill(level[x]);
+
+					for (int y: s.neighbors[x]) {
+						if (known[y]==-1) continue;
+
+						//a number going to or from 0 changes what its level floods
+						int v = number(y);
+						if ((v==0) != (known[y]==0)) kill(level[y]);
+						else if (v!=known[y]) {
+							seeds.push_back({y,level[y]});
+							set(y, v, level[y]);
+						}
+					}
+				}
+
+				invalidate();
+				sync_local();
+				deduce();
+
+				if (n_revealed>n_before) break;
+
+				//no better, undo the try
+				STAT_COUNT("generator.rollback", 1);
+				while (log.size()) {
+					auto [x,v,l] = log.back(); log.pop_back();
+					n_revealed += (v!=-1) - (known[x]!=-1);
+					known[x]=v, level[x]=l;
+					changed.push_back(x);
+				}
+
+				for (int l: killed) alive[l]=1;
+				level_pos.resize(n_levels);
+				level_cells.resize(n_levels);
+				alive.resize(n_levels);
+				move_hard.resize(n_levels);
+				move_depth.resize(n_levels);
+				start_level=old_start;
+
+				for (int x: flip) g[x]=!g[x];
+				sync(s);
+			}
+		}
+
+		return false;
+	}
+
 	bool generate() {
-		Solver s(h,w,n_mine);
-		vec<array<int,2>> move_stack;
+		STAT_TIME("generator.generate");
+		best_miss=INT_MAX;
+		if (local) return generate_local();
+
+		Solver<H,W> s(h,w,n_mine);
+
+		auto restart = [&]() {
+			move_stack.clear();
+			move_hard.clear();
+			move_depth.clear();
+			n_hard=0;
+
+			reset();
+			s.set_known(known);
+			changed.clear();
+		};
+
+		restart();
 
 		int ntry=0;
 		int size = min({h,w,5});
@@ -796,17 +1952,13 @@ struct Generator {
 
 			vector<int> to_check_bbox;
 
-			known.assign(h*w,-1);
-			int n_known=reveal(start_i, start_j);
-			for (int i=0; i<move_stack.size(); i++) {
-				if (known[move_stack[i][0]*w+move_stack[i][1]]==-1) {
-					n_known+=reveal(move_stack[i][0],move_stack[i][1]);
-				}
+			if (trail.size()==h*w-n_mine) {
+				if (accept()) return true;
+				gen_initial();
+				restart();
+				continue;
 			}
 
-			if (n_known==h*w-n_mine) return true;
-			s.set_known(known);
-
 			for (Cell c: s.state) {
 				if (g[c.position()]) continue;
 				int i = c.position()/w, j=c.position()%w;
@@ -815,95 +1967,274 @@ struct Generator {
 				}
 			}
 
-			auto old_g = g;
+			//steer new deductions toward the wanted difficulty
+			bool want_hard = n_hard<diff.min_deductions, want_easy = n_hard>=diff.max_deductions;
+
+			checkpoint();
 			if (to_check_bbox.empty()) {
 				if (!shift(1, {0,h-1,0,w-1})) continue;
+				refresh();
 			} else {
 				for (int ti=0; ti<25; ti++) {
 					if (!shift(2, {r1,r2,c1,c2})) continue;
+					if (!refresh()) continue;
 
-					known.assign(h*w,-1);
-					reveal(start_i,start_j);
-					bool cont=false;
-					for (int i=0; i<move_stack.size(); i++) {
-						if (g[move_stack[i][0]*w+move_stack[i][1]]) {cont=true; break;}
-						if (known[move_stack[i][0]*w+move_stack[i][1]]==-1) {
-							reveal(move_stack[i][0],move_stack[i][1]);
-						}
-					}
-
-					if (cont) continue;
-					s.set_known(known);
+					sync(s);
+					s.mine_possible();
 
 					bool ex=false;
 					for (int x: to_check_bbox) {
-						if (!s.can_be_mine(x)) {ex=true; break;}
+						int ci = s.state_idx[x];
+						if (ci==-1 ? known[x]==-1 && s.outside_can_mine : s.can_mine[ci]) continue;
+
+						bool trivial = ci==-1 ? known[x]!=-1 : s.trivially_safe(ci);
+						if ((want_hard && trivial) || (want_easy && !trivial)) continue;
+						if (!trivial && s.root->depth>diff.max_depth) continue;
+
+						ex=true; break;
 					}
 
 					if (ex) break;
 				}
 			}
 
-			known.assign(h*w,-1);
-			n_known = reveal(start_i, start_j);
+			//moves up to dirty_level were made with the same information as before
+			int l = min(dirty_level+1, int(level_begin.size()));
+			backtrack(l);
 
 			bool bad=false;
-			for (int i=0; i<move_stack.size(); i++) {
-				int x = move_stack[i][0]*w+move_stack[i][1];
-				if (known[x]!=-1) continue;
+			for (; l<=move_stack.size(); l++) {
+				auto [i,j] = move_stack[l-1];
+				level_begin.push_back(trail.size());
+				if (known[i*w+j]!=-1) continue;
 
-				if (g[x]) {
+				if (g[i*w+j]) {
 					bad=true; break;
 				}
 
-				s.set_known(known);
-				if (s.can_be_mine(x)) {
+				sync(s);
+				if (s.can_be_mine(i*w+j)) {
 					bad=true; break;
 				}
 				
-				n_known += reveal(move_stack[i][0], move_stack[i][1]);
+				reveal(i,j);
 			}
 
 			if (bad) {
 				if (++ntry > 100) {
 					ntry=0;
 					gen_initial();
-					move_stack.clear();
+					restart();
 					continue;
 				}
 
-				g=old_g;
+				rollback();
+				sync(s);
 				continue;
 			}
 
-			if (n_known==h*w-n_mine) return true;
+			sync(s);
 
-			while (true) {
-				s.set_known(known);
+			while (trail.size()<h*w-n_mine) {
+				s.mine_possible();
 
-				bool found=false;
-				for (int ci=-1; ci<int(s.state.size()); ci++) {
-					if (ci==-1 && s.outside_perimeter==-1) continue;
+				//take trivial moves first, like a player would
+				int x=-1;
+				for (int ci=0; ci<s.state.size(); ci++) {
+					if (!s.can_mine[ci] && s.trivially_safe(ci) && !g[s.state[ci].position()]) {
+						x=s.state[ci].position(); break;
+					}
+				}
 
-					int x = ci==-1 ? s.outside_perimeter : s.state[ci].position();
-					if (known[x]!=-1 || g[x] || s.can_be_mine(x)) continue;
+				bool hard = x==-1;
+				if (hard && s.root->depth<=diff.max_depth) {
+					for (int ci=-1; ci<int(s.state.size()); ci++) {
+						if (ci==-1 && s.outside_perimeter==-1) continue;
 
-					found=true;
-					move_stack.push_back(array<int,2>{x/w,x%w});
-					n_known += reveal(x/w,x%w);
+						int y = ci==-1 ? s.outside_perimeter : s.state[ci].position();
+						if (g[y] || (ci==-1 ? s.outside_can_mine : s.can_mine[ci])) continue;
 
-					if (n_known==h*w-n_mine) return true;
-					break;
+						x=y; break;
+					}
 				}
 
-				if (!found) break;
+				if (x==-1) break;
+
+				move_stack.push_back(array<int,2>{x/w,x%w});
+				move_hard.push_back(hard);
+				move_depth.push_back(hard ? s.root->depth : 0);
+				n_hard+=hard;
+
+				level_begin.push_back(trail.size());
+				reveal(x/w,x%w);
+				sync(s);
 			}
 		}
 
-		return false;
+		if (trail.size()==h*w-n_mine && accept()) return true;
+		if (best_miss==INT_MAX) return false;
+
+		g=best_g;
+		metrics=best_metrics;
+		return true;
+	}
+};
+
+//everything that determines a generated board
+struct BoardKey {
+	int32_t h,w,mines,si,sj;
+	int32_t min_deductions, max_deductions, max_depth, min_3bv, max_3bv;
+	uint64_t seed;
+
+	bool operator==(BoardKey const& other) const {return memcmp(this, &other, sizeof(BoardKey))==0;}
+
+	struct Hasher {
+		uint64_t operator()(BoardKey const& k) const {
+			//splitmix64 over the fields
+			uint64_t out=0;
+			auto mix = [&](uint64_t x) {
+				out += x + 0x9e3779b97f4a7c15;
+				out = (out^(out>>30))*0xbf58476d1ce4e5b9;
+				out = (out^(out>>27))*0x94d049bb133111eb;
+				out ^= out>>31;
+			};
+
+			int32_t const* xs = &k.h;
+			for (int i=0; i<10; i++) mix(uint32_t(xs[i]));
+			mix(k.seed);
+			return out;
+		}
+	};
+};
+
+static_assert(sizeof(BoardKey)==48);
+
+//append-only file of generated boards, so a seeded request is only ever generated once
+//layout: magic, then for each board its BoardKey followed by h*w mine bits packed into 64-bit words
+//the file is mapped and indexed once on open. writers append whole records under an exclusive lock,
+//a record cut short by a crash is ignored
+struct BoardCache {
+	constexpr static uint64_t magic = 0x31454843414e494d; //"MINACHE1"
+
+	int fd;
+	char const* data=nullptr;
+	size_t size=0;
+
+	#ifndef BUILD_DEBUG
+	gtl::flat_hash_map<BoardKey, size_t, BoardKey::Hasher> index;
+	#else
+	unordered_map<BoardKey, size_t, BoardKey::Hasher> index;
+	#endif
+
+	static size_t n_words(BoardKey const& k) {return (size_t(k.h)*k.w+63)/64;}
+
+	BoardCache(string const& path) {
+		fd = open(path.c_str(), O_RDWR|O_CREAT|O_APPEND, 0644);
+		if (fd==-1) throw runtime_error("can't open board cache "+path);
+
+		flock(fd, LOCK_SH);
+		struct stat st;
+		if (fstat(fd, &st)==0) size=st.st_size;
+		if (size>0) {
+			void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+			if (p==MAP_FAILED) size=0;
+			else data=static_cast<char const*>(p);
+		}
+		flock(fd, LOCK_UN);
+
+		if (size>0 && (size<sizeof(magic) || memcmp(data, &magic, sizeof(magic))!=0))
+			throw runtime_error(path+" isn't a board cache");
+
+		for (size_t off=sizeof(magic); off+sizeof(BoardKey)<=size;) {
+			BoardKey k;
+			memcpy(&k, data+off, sizeof(BoardKey));
+			if (k.h<=0 || k.w<=0) break;
+
+			size_t end = off+sizeof(BoardKey)+n_words(k)*sizeof(uint64_t);
+			if (end>size) break;
+
+			index[k]=off+sizeof(BoardKey);
+			off=end;
+		}
+	}
+
+	~BoardCache() {
+		if (data) munmap(const_cast<char*>(data), size);
+		close(fd);
+	}
+
+	bool get(BoardKey const& k, vec<bool>& g) {
+		auto it = index.find(k);
+		if (it==index.end()) return false;
+
+		g.assign(k.h*k.w, false);
+		for (int x=0; x<k.h*k.w; x++) {
+			uint64_t word;
+			memcpy(&word, data+it->second+(x/64)*sizeof(uint64_t), sizeof(uint64_t));
+			g[x] = (word>>(x%64))&1;
+		}
+
+		return true;
+	}
+
+	void put(BoardKey const& k, vec<bool> const& g) {
+		vec<uint64_t> words(n_words(k), 0);
+		for (int x=0; x<k.h*k.w; x++) if (g[x]) words[x/64] |= uint64_t(1)<<(x%64);
+
+		string buf(sizeof(BoardKey)+words.size()*sizeof(uint64_t), '\0');
+		memcpy(buf.data(), &k, sizeof(BoardKey));
+		memcpy(buf.data()+sizeof(BoardKey), words.data(), words.size()*sizeof(uint64_t));
+
+		flock(fd, LOCK_EX);
+		struct stat st;
+		if (fstat(fd, &st)==0 && st.st_size==0)
+			buf.insert(0, reinterpret_cast<char const*>(&magic), sizeof(magic));
+
+		if (write(fd, buf.data(), buf.size())!=buf.size()) {
+			flock(fd, LOCK_UN);
+			throw runtime_error("couldn't write to board cache");
+		}
+
+		flock(fd, LOCK_UN);
 	}
 };
 
+//checks the parameters, then looks the board up in the cache at cache_path (if any) or generates and caches it
+//an unseeded key gets a random seed. false if generation failed
+bool generate_board(BoardKey const& key, bool seeded, string const& cache_path, vec<bool>& g) {
+	auto [h,w,mines,si,sj] = array<int,5>{key.h, key.w, key.mines, key.si, key.sj};
+	//sides first, so h*w can't overflow
+	if (h<=0 || w<=0 || h>1000 || w>1000 || si<0 || sj<0 || si>=h || sj>=w || mines>=int64_t(h)*w-9 || mines<0) {
+		cerr<<"received parameters h="<<h<<" w="<<w<<" mines="<<mines<<" si="<<si<<" sj="<<sj<<endl;
+		throw runtime_error("invalid parameters");
+	}
+
+	//unseeded boards are never looked up again, so they aren't cached
+	if (!cache_path.empty() && !seeded) throw runtime_error("cache needs a seed");
+
+	optional<BoardCache> cache;
+	if (!cache_path.empty()) {
+		cache.emplace(cache_path);
+		if (cache->get(key, g)) return true;
+	}
+
+	Difficulty diff {
+		.min_deductions=key.min_deductions, .max_deductions=key.max_deductions,
+		.max_depth=key.max_depth, .min_3bv=key.min_3bv, .max_3bv=key.max_3bv
+	};
+
+	return with_board_size(h, w, [&]<int H, int W>(BoardSize<H,W>) {
+		Generator<H,W> gen(h,w,si,sj,mines, seeded ? key.seed : random_device{}(), diff);
+		if (!gen.generate()) return false;
+		if (cache) cache->put(key, gen.g);
+
+		g=std::move(gen.g);
+		return true;
+	});
+}
+
+//benchmarks and libkiosk include this file for the solver and generator
+#ifndef MINESWEEPER_NO_MAIN
 int main(int argc, char** argv) {
 // 	int arr[] = {
 //   [0] = -1,
@@ -1016,20 +2347,98 @@ int main(int argc, char** argv) {
 	// 	2,-1,-1
 	// });
 	// Generator gen(16,16,4,4,99);
+	report_stats_on_exit();
+
 	stringstream ss;
 	for (int i=1; i<argc; i++) ss<<argv[i]<<"\n";
 
+	if (argc>1 && string(argv[1])=="hint") {
+		string cmd;
+		int h,w,mines;
+		ss>>cmd>>h>>w>>mines;
+
+		if (h<=0 || w<=0 || int64_t(h)*w>50*50 || mines<0 || mines>=int64_t(h)*w) {
+			cerr<<"received parameters h="<<h<<" w="<<w<<" mines="<<mines<<endl;
+			throw runtime_error("invalid parameters");
+		}
+
+		//one board per line, row-major: . for unknown or the revealed number
+		//kept alive for the whole game so the solver's cache stays warm between queries
+		with_board_size(h, w, [&]<int H, int W>(BoardSize<H,W>) {
+			Solver<H,W> solver(h,w,mines);
+			solver.set_known(vec<int>(h*w,-1));
+
+			string line;
+			vec<int> new_known(h*w), changed;
+			while (getline(cin, line)) {
+				if (line.size()!=h*w) throw runtime_error("invalid board");
+
+				changed.clear();
+				for (int i=0; i<h*w; i++) {
+					if (line[i]!='.' && (line[i]<'0' || line[i]>'8')) throw runtime_error("invalid board");
+					new_known[i] = line[i]=='.' ? -1 : line[i]-'0';
+					if (new_known[i]!=solver.known[i]) changed.push_back(i);
+				}
+
+				solver.update_known(changed, new_known);
+				auto res = solver.hint();
+
+				if (auto const* hint = get_if<typename Solver<H,W>::Hint>(&res)) {
+					auto print_cells = [&](vec<int> const& cells) {
+						cout<<"[";
+						for (int i=0; i<cells.size(); i++)
+							cout<<(i ? "," : "")<<"["<<cells[i]/w<<","<<cells[i]%w<<"]";
+						cout<<"]";
+					};
+
+					cout<<"{\"safe\":"; print_cells(hint->safe);
+					cout<<",\"mine\":"; print_cells(hint->mine);
+					cout<<",\"prob\":[";
+					for (int i=0; i<h; i++) {
+						cout<<(i ? ",[" : "[");
+						for (int j=0; j<w; j++) {
+							cout<<(j ? "," : "")<<round(hint->prob[i*w+j]*1000)/1000;
+						}
+						cout<<"]";
+					}
+					cout<<"]}"<<endl;
+				} else {
+					cout<<"null"<<endl;
+				}
+			}
+		});
+
+		return 0;
+	}
+
 	int h,w,mines,si,sj;
 	ss>>h>>w>>mines>>si>>sj;
-	
-	if (h*w<=0 || h*w>50*50 || si<0 || sj<0 || si>=h || sj>=w || mines>=h*w-9 || mines<0) {
-		cerr<<"received parameters h="<<h<<" w="<<w<<" mines="<<mines<<" si="<<si<<" sj="<<sj<<endl;
-		throw runtime_error("invalid parameters");
+
+	Difficulty diff;
+	optional<uint64_t> seed;
+	string opt, cache_path;
+	bool bits=false;
+	while (ss>>opt) {
+		if (opt=="deductions") ss>>diff.min_deductions>>diff.max_deductions;
+		else if (opt=="depth") ss>>diff.max_depth;
+		else if (opt=="3bv") ss>>diff.min_3bv>>diff.max_3bv;
+		else if (opt=="seed") ss>>seed.emplace();
+		else if (opt=="cache") ss>>cache_path;
+		else if (opt=="bits") bits=true;
+		else throw runtime_error("unknown option "+opt);
 	}
 	
-	Generator gen(h,w,si,sj,mines, random_device{}());
-	if (!gen.generate()) return 1;
-	gen.print_mine_pos(cout);
+	BoardKey key {
+		h,w,mines,si,sj,
+		diff.min_deductions, diff.max_deductions, diff.max_depth, diff.min_3bv, diff.max_3bv,
+		seed.value_or(0)
+	};
+
+	vec<bool> g;
+	if (!generate_board(key, seed.has_value(), cache_path, g)) return 1;
+
+	if (bits) print_mine_bits(cout, h, w, g);
+	else print_mine_pos(cout, h, w, g);
 
 	// cout<<"\n\nboard done\n\n";
 
@@ -1042,3 +2451,4 @@ int main(int argc, char** argv) {
 	// }
 	return 0;
 }
+#endif
@@ -0,0 +1,113 @@
+#pragma once
+
+//counters and timers for the hot paths of main and wiki
+//compiled out unless ENGINE_STATS is defined (cmake -DENGINE_STATS=ON). when on, everything collected
+//is printed to stderr as one json line on exit: {"stats":{"counters":{...},"timers":{name:{"calls":n,"sec":t}}}}
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string_view>
+#include <utility>
+
+#ifdef ENGINE_STATS
+
+//each site registers itself in a list the first time it runs. nothing here has a destructor,
+//so they're still around when the exit handler prints them. values and the list heads are atomic
+//since the library and extract hit the same sites, and run different sites for the first time, from several threads
+struct StatCounter {
+	char const* name;
+	//from STAT_MAX, so sites sharing its name are merged by taking the max
+	bool is_max;
+	std::atomic<uint64_t> value=0;
+	StatCounter* next;
+
+	inline static std::atomic<StatCounter*> head=nullptr;
+	StatCounter(char const* stat_name, bool max=false): name(stat_name), is_max(max), next(head.load()) {
+		while (!head.compare_exchange_weak(next, this));
+	}
+};
+
+struct StatTimer {
+	char const* name;
+	std::atomic<uint64_t> calls=0, ns=0;
+	StatTimer* next;
+
+	inline static std::atomic<StatTimer*> head=nullptr;
+	StatTimer(char const* stat_name): name(stat_name), next(head.load()) {
+		while (!head.compare_exchange_weak(next, this));
+	}
+};
+
+struct StatScope {
+	StatTimer& timer;
+	std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+
+	StatScope(StatTimer& scope_timer): timer(scope_timer) {}
+	~StatScope() {
+		timer.calls++;
+		timer.ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+	}
+};
+
+//sites sharing a name (the same name used twice, or a site in a template instantiated several times) are added up,
+//or for STAT_MAX the largest kept, so each name is printed once
+inline void print_stats(std::ostream& os) {
+	std::map<std::string_view, uint64_t> counters;
+	for (StatCounter* c=StatCounter::head; c; c=c->next) {
+		uint64_t& v = counters[c->name];
+		v = c->is_max ? std::max<uint64_t>(v, c->value) : v+c->value;
+	}
+
+	std::map<std::string_view, std::pair<uint64_t,uint64_t>> timers;
+	for (StatTimer* t=StatTimer::head; t; t=t->next) {
+		auto& [calls, ns] = timers[t->name];
+		calls+=t->calls, ns+=t->ns;
+	}
+
+	os<<"{\"stats\":{\"counters\":{";
+	for (bool first=true; auto const& [name, v]: counters) {
+		os<<(first ? "" : ",")<<"\""<<name<<"\":"<<v;
+		first=false;
+	}
+
+	os<<"},\"timers\":{";
+	for (bool first=true; auto const& [name, t]: timers) {
+		os<<(first ? "" : ",")<<"\""<<name<<"\":{\"calls\":"<<t.first<<",\"sec\":"<<t.second/1e9<<"}";
+		first=false;
+	}
+
+	os<<"}}}"<<std::endl;
+}
+
+inline void report_stats_on_exit() {
+	std::atexit([]() {print_stats(std::cerr);});
+}
+
+#define STAT_CAT2(a,b) a##b
+#define STAT_CAT(a,b) STAT_CAT2(a,b)
+
+#define STAT_COUNT(name, n) do { static StatCounter stat_counter_(name); stat_counter_.value += (n); } while (0)
+#define STAT_MAX(name, v) do { \
+		static StatCounter stat_counter_(name, true); \
+		uint64_t stat_v_=(v), stat_old_=stat_counter_.value; \
+		while (stat_old_<stat_v_ && !stat_counter_.value.compare_exchange_weak(stat_old_, stat_v_)); \
+	} while (0)
+#define STAT_TIME(name) \
+	static StatTimer STAT_CAT(stat_timer_, __LINE__)(name); \
+	StatScope STAT_CAT(stat_scope_, __LINE__)(STAT_CAT(stat_timer_, __LINE__))
+
+#else
+
+inline void print_stats(std::ostream&) {}
+inline void report_stats_on_exit() {}
+
+#define STAT_COUNT(name, n) do {} while (0)
+#define STAT_MAX(name, v) do {} while (0)
+#define STAT_TIME(name) do {} while (0)
+
+#endif
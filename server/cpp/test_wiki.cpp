@@ -0,0 +1,120 @@
+#define WIKI_NO_MAIN
+#include "wiki.cpp"
+
+#include <filesystem>
+#include <functional>
+
+//each test throws on failure, main runs all of them and returns 1 if any did
+
+void check(bool cond, string const& what) {
+	if (!cond) throw runtime_error(what);
+}
+
+struct TempFile {
+	string path;
+	TempFile(string const& name): path((filesystem::temp_directory_path()/("test_wiki_"+name)).string()) {}
+	~TempFile() {filesystem::remove(path);}
+};
+
+//looks like a dump, but random enough that it takes several (1<<20 byte) chunks compressed
+string dump_text(size_t n) {
+	string out;
+	mt19937 rng(1);
+	while (out.size()<n) out+="("+to_string(rng())+",0,'Page_"+to_string(rng()%100000)+"'),";
+	out.resize(n);
+	return out;
+}
+
+string read_dump(string const& path) {
+	DumpBuf buf(path);
+	istream in(&buf);
+	in.exceptions(ios::badbit);
+	return string(istreambuf_iterator<char>(in), {});
+}
+
+void write_file(string const& path, string const& x) {
+	ofstream(path, ios::binary).write(x.data(), x.size());
+}
+
+string gzip(string const& x) {
+	z_stream zs {};
+	check(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16+MAX_WBITS, 8, Z_DEFAULT_STRATEGY)==Z_OK, "deflateInit2");
+
+	string out(deflateBound(&zs, x.size()), '\0');
+	zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(x.data()));
+	zs.avail_in = x.size();
+	zs.next_out = reinterpret_cast<Bytef*>(out.data());
+	zs.avail_out = out.size();
+	check(deflate(&zs, Z_FINISH)==Z_STREAM_END, "deflate");
+
+	out.resize(zs.total_out);
+	deflateEnd(&zs);
+	return out;
+}
+
+string zstd(string const& x) {
+	string out(ZSTD_compressBound(x.size()), '\0');
+	size_t res = ZSTD_compress(out.data(), out.size(), x.data(), x.size(), 3);
+	check(!ZSTD_isError(res), "ZSTD_compress");
+	out.resize(res);
+	return out;
+}
+
+//several input chunks long, each inflating to more than one output chunk, and every byte has to come out
+void test_dump_chunks() {
+	string text = dump_text(size_t(10)<<20);
+	TempFile f("dump");
+
+	for (auto [name, comp]: {pair{"gzip", gzip(text)}, pair{"zstd", zstd(text)}}) {
+		check(comp.size()>size_t(2)<<20, string(name)+" input fits in 2 chunks");
+		write_file(f.path, comp);
+
+		string out = read_dump(f.path);
+		check(out.size()==text.size(), string(name)+" read "+to_string(out.size())+" of "+to_string(text.size())+" bytes");
+		check(out==text, string(name)+" output differs");
+	}
+
+	//dumps can be several gzip members
+	write_file(f.path, gzip(text)+gzip(text));
+	check(read_dump(f.path).size()==2*text.size(), "2 member gzip");
+
+	write_file(f.path, text);
+	check(read_dump(f.path)==text, "plain");
+}
+
+void test_dump_truncated() {
+	string text = dump_text(size_t(3)<<20);
+	TempFile f("dump");
+
+	for (string comp: {gzip(text), zstd(text)}) {
+		write_file(f.path, comp.substr(0, comp.size()/2));
+		bool threw=false;
+		try {
+			read_dump(f.path);
+		} catch (runtime_error const&) {
+			threw=true;
+		}
+
+		check(threw, "truncated dump");
+	}
+}
+
+int main() {
+	pair<char const*, function<void()>> tests[] = {
+		{"dump_chunks", test_dump_chunks},
+		{"dump_truncated", test_dump_truncated},
+	};
+
+	int failed=0;
+	for (auto& [name, f]: tests) {
+		try {
+			f();
+			cout<<"ok "<<name<<"\n";
+		} catch (exception const& e) {
+			cout<<"FAILED "<<name<<": "<<e.what()<<"\n";
+			failed++;
+		}
+	}
+
+	return failed ? 1 : 0;
+}
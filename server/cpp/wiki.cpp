@@ -1,4 +1,6 @@
+#include <charconv>
 #include <cstdlib>
+#include <cstring>
 #include <ios>
 #include <random>
 #include <regex>
@@ -8,11 +10,29 @@
 #include <iostream>
 #include <fstream>
 #include <array>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zlib.h>
+#include <zstd.h>
+#include <zdict.h>
 
 #include <gtl/phmap.hpp>
 #include <gtl/vector.hpp>
 #include <gtl/bit_vector.hpp>
 
+#include "stats.hpp"
+
 using namespace std;
 
 template<class T>
@@ -29,21 +49,227 @@ constexpr int wiki_ns = 0;
 struct SQLNull {};
 using Value = variant<string,int64_t,SQLNull>;
 
+//one write per line, so progress from the extract threads doesn't interleave
+template<class... Args>
+void progress(Args const&... args) {
+	stringstream ss;
+	(ss<<...<<args);
+	cout<<ss.str();
+}
+
+//threads whose exceptions are kept for join() to rethrow, instead of reaching std::terminate
+class Tasks {
+	mutex m;
+	exception_ptr error;
+	vector<jthread> threads;
+
+public:
+	template<class F>
+	void run(F f) {
+		threads.emplace_back([this, f=std::move(f)]() {
+			try {
+				f();
+			} catch (...) {
+				lock_guard lock(m);
+				if (!error) error=current_exception();
+			}
+		});
+	}
+
+	//waits for every thread, then throws the first exception any of them threw
+	void join() {
+		for (jthread& t: threads) t.join();
+		threads.clear();
+		if (error) rethrow_exception(error);
+	}
+};
+
+//runs f(begin, end) on [0,n) split between the hardware threads
+template<class F>
+void parallel_for(size_t n, F f) {
+	size_t n_thread = max(1u, thread::hardware_concurrency());
+	Tasks tasks;
+	for (size_t t=0; t<n_thread; t++) {
+		size_t begin=n*t/n_thread, end=n*(t+1)/n_thread;
+		if (begin<end) tasks.run([&f, begin, end]() {f(begin, end);});
+	}
+
+	tasks.join();
+}
+
+//a dump as a streambuf, decompressing gzip (*.sql.gz) and zstd on the fly, picked by magic bytes.
+//reading and decompressing run on their own thread a few chunks ahead of the parser, and
+//compressed_read() is how much of the file that's gotten through, for progress
+class DumpBuf: public streambuf {
+	static constexpr size_t chunk=1<<20, max_ahead=4;
+
+	ifstream file;
+	mutex m;
+	condition_variable cv;
+	deque<string> ready;
+	string cur;
+	bool done=false, stop=false;
+	exception_ptr error;
+	atomic<size_t> read_amt=0;
+	jthread worker;
+
+	//false once the worker should stop
+	bool push(string&& out) {
+		unique_lock lock(m);
+		cv.wait(lock, [&]() {return stop || ready.size()<max_ahead;});
+		if (stop) return false;
+		ready.push_back(std::move(out));
+		cv.notify_all();
+		return true;
+	}
+
+	//next compressed chunk in in, empty at eof
+	void read_in(string& in) {
+		in.resize(chunk);
+		file.read(in.data(), chunk);
+		in.resize(file.gcount());
+		read_amt+=in.size();
+	}
+
+	void run_plain() {
+		string in;
+		while (read_in(in), in.size() && push(std::move(in)));
+	}
+
+	void run_gzip() {
+		z_stream zs {};
+		//+16 for a gzip header
+		if (inflateInit2(&zs, 16+MAX_WBITS)!=Z_OK) throw runtime_error("inflateInit2 failed");
+		unique_ptr<z_stream, decltype(&inflateEnd)> guard(&zs, inflateEnd);
+
+		string in, out;
+		bool in_member=false;
+		while (read_in(in), in.size()) {
+			zs.next_in = reinterpret_cast<Bytef*>(in.data());
+			zs.avail_in = in.size();
+			in_member=true;
+
+			//a full output can mean there's more, even with the input used up
+			bool full=false;
+			while (zs.avail_in || full) {
+				out.resize(chunk);
+				zs.next_out = reinterpret_cast<Bytef*>(out.data());
+				zs.avail_out = chunk;
+
+				int res = inflate(&zs, Z_NO_FLUSH);
+				//dumps can be several gzip members back to back
+				if (res==Z_STREAM_END) inflateReset(&zs), in_member=zs.avail_in>0;
+				else if (res!=Z_OK && res!=Z_BUF_ERROR) throw runtime_error(string("gzip: ")+(zs.msg ? zs.msg : "error"));
+
+				full = zs.avail_out==0;
+				out.resize(chunk-zs.avail_out);
+				if (out.size() && !push(std::move(out))) return;
+			}
+		}
+
+		if (in_member) throw runtime_error("gzip: truncated");
+	}
+
+	void run_zstd() {
+		unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> ctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+		if (!ctx) throw runtime_error("ZSTD_createDCtx failed");
+
+		string in, out;
+		//0 once a frame is complete
+		size_t res=0;
+		while (read_in(in), in.size()) {
+			ZSTD_inBuffer zin {in.data(), in.size(), 0};
+			bool full=false;
+			//res is 0 once everything in a frame has been written
+			while (zin.pos<zin.size || (full && res!=0)) {
+				out.resize(chunk);
+				ZSTD_outBuffer zout {out.data(), chunk, 0};
+
+				res = ZSTD_decompressStream(ctx.get(), &zout, &zin);
+				if (ZSTD_isError(res)) throw runtime_error(string("zstd: ")+ZSTD_getErrorName(res));
+
+				full = zout.pos==zout.size;
+				out.resize(zout.pos);
+				if (out.size() && !push(std::move(out))) return;
+			}
+		}
+
+		if (res!=0) throw runtime_error("zstd: truncated");
+	}
+
+	int_type underflow() override {
+		unique_lock lock(m);
+		cv.wait(lock, [&]() {return done || ready.size();});
+		if (ready.empty()) {
+			if (error) rethrow_exception(error);
+			return traits_type::eof();
+		}
+
+		cur = std::move(ready.front());
+		ready.pop_front();
+		cv.notify_all();
+
+		setg(cur.data(), cur.data(), cur.data()+cur.size());
+		return traits_type::to_int_type(cur[0]);
+	}
+
+public:
+	size_t compressed_size;
+
+	DumpBuf(string const& path): file(path, ios::binary) {
+		if (!file) throw runtime_error("can't open "+path);
+		compressed_size = filesystem::file_size(path);
+
+		array<unsigned char,4> magic {};
+		file.read(reinterpret_cast<char*>(magic.data()), magic.size());
+		file.clear();
+		file.seekg(0);
+
+		worker = jthread([this, magic]() {
+			try {
+				if (magic[0]==0x1f && magic[1]==0x8b) run_gzip();
+				else if (magic==array<unsigned char,4>{0x28,0xb5,0x2f,0xfd}) run_zstd();
+				else run_plain();
+			} catch (...) {
+				error = current_exception();
+			}
+
+			lock_guard lock(m);
+			done=true;
+			cv.notify_all();
+		});
+	}
+
+	~DumpBuf() {
+		{
+			lock_guard lock(m);
+			stop=true;
+			cv.notify_all();
+		}
+
+		worker.join();
+	}
+
+	size_t compressed_read() const {return read_amt;}
+};
+
 template<class F>
-void parse(istream& input, F f) {
+void parse(string const& path, string const& name, F f) {
+	STAT_TIME("wiki.parse");
+	DumpBuf dump(path);
+	istream input(&dump);
+	//errors from the decompressor go through underflow, so they shouldn't just set badbit
+	input.exceptions(ios::badbit);
 	input>>noskipws;
 
 	regex re("^INSERT INTO `[^`]+` VALUES $");
 
-	input.seekg(0,ios_base::end);
-	auto total = input.tellg();
-	input.seekg(0,ios_base::beg);
-
+	size_t total = dump.compressed_size;
 	size_t diff = 1e7, next_amt=diff;
 	while (input) {
-		size_t amt = input.tellg();
+		size_t amt = dump.compressed_read();
 		if (amt>next_amt) {
-			cout<<"read "<<amt<<"/"<<total<<" ("<<100.0*amt/total<<"%)\n";
+			progress(name, ": read ", amt, "/", total, " (", 100.0*amt/total, "%)\n");
 			next_amt=amt+diff;
 		}
 
@@ -112,6 +338,343 @@ void parse(istream& input, F f) {
 	}
 }
 
+//adjacency lists as written to data.bin: i's list is to[end[i-1]..end[i])
+struct Csr {
+	gtl::vector<int> end, to;
+};
+
+//csr for edges {from, to} (or {to, from} if rev) by a parallel counting sort, skipping edges with from=-1
+//lists are sorted without duplicates
+Csr build_csr(int n, gtl::vector<array<int,2>> const& edges, bool rev) {
+	int a=rev, b=!rev;
+
+	vector<atomic<size_t>> pos(n);
+	parallel_for(edges.size(), [&](size_t l, size_t r) {
+		for (size_t i=l; i<r; i++)
+			if (edges[i][0]!=-1) pos[edges[i][a]].fetch_add(1, memory_order_relaxed);
+	});
+
+	gtl::vector<size_t> start(n+1);
+	for (int i=0; i<n; i++) {
+		start[i+1] = start[i]+pos[i];
+		pos[i] = start[i];
+	}
+
+	gtl::vector<int> to(start[n]);
+	parallel_for(edges.size(), [&](size_t l, size_t r) {
+		for (size_t i=l; i<r; i++) {
+			if (edges[i][0]!=-1) to[pos[edges[i][a]].fetch_add(1, memory_order_relaxed)] = edges[i][b];
+		}
+	});
+
+	gtl::vector<int> len(n);
+	parallel_for(n, [&](size_t l, size_t r) {
+		for (size_t i=l; i<r; i++) {
+			sort(to.begin()+start[i], to.begin()+start[i+1]);
+			len[i] = unique(to.begin()+start[i], to.begin()+start[i+1])-(to.begin()+start[i]);
+		}
+	});
+
+	Csr out;
+	out.end.resize(n);
+	size_t cur=0;
+	for (int i=0; i<n; i++) {
+		cur+=len[i];
+		if (cur>numeric_limits<int>::max()) throw runtime_error("too many links");
+		out.end[i]=cur;
+	}
+
+	out.to.resize(cur);
+	parallel_for(n, [&](size_t l, size_t r) {
+		for (size_t i=l; i<r; i++)
+			copy_n(to.begin()+start[i], len[i], out.to.begin()+(i==0 ? 0 : out.end[i-1]));
+	});
+
+	return out;
+}
+
+template<class T, size_t N>
+array<T,N> convert(array<T,N> x) {
+	for (T& y: x) y=convert(y);
+	return x;
+}
+
+//converted in chunks instead of a write per int
+template<class T>
+void write_big(ostream& os, gtl::vector<T> const& xs, T add=T()) {
+	gtl::vector<T> buf;
+	for (size_t i=0; i<xs.size(); i+=1<<16) {
+		buf.assign(xs.begin()+i, xs.begin()+min(xs.size(), i+(1<<16)));
+		for (T& x: buf) {
+			if constexpr (is_arithmetic_v<T>) x=convert(T(x+add));
+			else x=convert(x);
+		}
+
+		os.write(reinterpret_cast<char*>(buf.data()), buf.size()*sizeof(T));
+	}
+}
+
+template<class T>
+void read_big(istream& is, gtl::vector<T>& xs) {
+	is.read(reinterpret_cast<char*>(xs.data()), sizeof(T)*xs.size());
+	for (T& x: xs) x=convert(x);
+}
+
+//with the length first, for extract's checkpoints
+template<class T>
+void write_vec(ostream& os, gtl::vector<T> const& xs) {
+	write_big(os, gtl::vector<uint64_t>{xs.size()});
+	write_big(os, xs);
+}
+
+template<class T>
+void read_vec(istream& is, gtl::vector<T>& xs) {
+	gtl::vector<uint64_t> len(1);
+	read_big(is, len);
+	xs.resize(len[0]);
+	read_big(is, xs);
+}
+
+//pages at a time whose contributions fit in cache together, 8MB of floats
+constexpr int rank_block = 1<<21;
+
+//pagerank by power iteration with damping 0.85, links from pages without any spread over every page.
+//each iteration pulls along rev_adj, which build_csr leaves sorted, so threads own disjoint ranges of pages
+//and sweep the sources one rank_block at a time, keeping the contributions they read in cache
+gtl::vector<float> pagerank(Csr const& adj, Csr const& rev_adj) {
+	STAT_TIME("wiki.pagerank");
+	constexpr double damping=0.85, tol=1e-6;
+	constexpr int max_iter=100;
+
+	int n = adj.end.size();
+	auto start = [](Csr const& c, int i) {return i==0 ? 0 : c.end[i-1];};
+
+	gtl::vector<float> rank(n, 1.0/n), contrib(n);
+	gtl::vector<double> sum(n);
+	gtl::vector<int> cursor(n);
+
+	for (int it=0; it<max_iter; it++) {
+		double dangling=0;
+		for (int i=0; i<n; i++) {
+			int deg = adj.end[i]-start(adj,i);
+			if (deg==0) dangling+=rank[i];
+			contrib[i] = deg==0 ? 0 : rank[i]/deg;
+		}
+
+		double base = (1-damping)/n + damping*dangling/n;
+		atomic<double> change=0;
+
+		parallel_for(n, [&](size_t l, size_t r) {
+			for (size_t i=l; i<r; i++) sum[i]=0, cursor[i]=start(rev_adj,i);
+
+			for (int block=rank_block; block-rank_block<n; block+=rank_block) {
+				for (size_t i=l; i<r; i++) {
+					int j=cursor[i];
+					for (; j<rev_adj.end[i] && rev_adj.to[j]<block; j++) sum[i]+=contrib[rev_adj.to[j]];
+					cursor[i]=j;
+				}
+			}
+
+			double local_change=0;
+			for (size_t i=l; i<r; i++) {
+				float x = base+damping*sum[i];
+				local_change+=abs(x-rank[i]);
+				rank[i]=x;
+			}
+
+			change+=local_change;
+		});
+
+		progress("pagerank iteration ", it, ", change ", change.load(), "\n");
+		if (change<tol) break;
+	}
+
+	return rank;
+}
+
+//floats go in data.bin as their bits
+gtl::vector<uint32_t> rank_bits(gtl::vector<float> const& rank) {
+	gtl::vector<uint32_t> out(rank.size());
+	for (size_t i=0; i<rank.size(); i++) out[i]=bit_cast<uint32_t>(rank[i]);
+	return out;
+}
+
+//hops covered by the distance profiles in data.idx, enough for the 7+ games
+constexpr int profile_h = 8;
+
+//what `wiki analyze` knows about how far a page is from everything else, from bfs to/from random landmark pages.
+//forward profiles count distances from the page to the landmarks, backward ones from the landmarks to the page
+struct Profile {
+	uint8_t ecc=0; //largest distance seen, a lower bound on the eccentricity
+	uint8_t far[profile_h+1] {}; //far[h] = # of landmarks at distance h or more (far[0] = reachable)
+};
+
+//distances from source over g (rev_adj for distances to it), 255 where unreached
+void bfs_dist(Csr const& g, int source, gtl::vector<uint8_t>& dist, gtl::vector<int>& q) {
+	fill(dist.begin(), dist.end(), 255);
+	dist[source]=0;
+	q.assign(1, source);
+
+	for (size_t qi=0; qi<q.size(); qi++) {
+		int x=q[qi];
+		if (dist[x]==254) break;
+
+		for (int j=x==0 ? 0 : g.end[x-1]; j<g.end[x]; j++) {
+			int y=g.to[j];
+			if (dist[y]!=255) continue;
+			dist[y]=dist[x]+1;
+			q.push_back(y);
+		}
+	}
+}
+
+constexpr int sample_far_tries = 32;
+
+//data.idx is "WIKIIDX2", then n, profile_h and the # of landmarks as big endian ints, the size (before the
+//checksum, int64) and checksum (uint32) of the data.bin it was computed from, the histogram of distances
+//from landmarks to every page (256 int64s, 255 for unreachable), then the n forward profiles and the n backward ones
+constexpr array<char,8> index_magic {'W','I','K','I','I','D','X','2'};
+constexpr int hist_len = 256;
+constexpr size_t index_header = sizeof(index_magic) + 3*sizeof(int) + sizeof(int64_t) + sizeof(uint32_t)
+	+ hist_len*sizeof(int64_t);
+
+string index_path(string const& data_path) {
+	return filesystem::path(data_path).replace_extension(".idx").string();
+}
+
+//files a running server can have open are written beside where they go and renamed over the old version once
+//complete, so whatever has the old one open keeps reading it until it reopens
+string temp_path(string const& path) {
+	return path+".tmp";
+}
+
+void replace_file(string const& path) {
+	filesystem::rename(temp_path(path), path);
+}
+
+//data.bin ends with "WIKICRC1" and the crc32 of everything before it (big endian), so a new version can be
+//checked before it's swapped in for the old one. files written before this don't have it
+constexpr array<char,8> checksum_magic {'W','I','K','I','C','R','C','1'};
+constexpr size_t checksum_size = checksum_magic.size()+sizeof(uint32_t);
+
+uint32_t crc_of(istream& in, size_t len) {
+	gtl::vector<char> buf(1<<22);
+	uLong crc = crc32_z(0, nullptr, 0);
+	while (len>0) {
+		size_t k = min(len, buf.size());
+		if (!in.read(buf.data(), k)) throw runtime_error("file shrank while checksumming");
+		crc = crc32_z(crc, reinterpret_cast<Bytef const*>(buf.data()), k);
+		len-=k;
+	}
+
+	return crc;
+}
+
+//the checksum at the end of in, if there is one. size is in's size, and becomes the size of what's before it
+optional<uint32_t> read_checksum(istream& in, size_t& size) {
+	if (size<checksum_size) return nullopt;
+
+	array<char,8> magic;
+	gtl::vector<uint32_t> crc(1);
+	in.seekg(size-checksum_size);
+	in.read(magic.data(), magic.size());
+	read_big(in, crc);
+	if (!in || magic!=checksum_magic) return nullopt;
+
+	size-=checksum_size;
+	return crc[0];
+}
+
+void append_checksum(string const& path) {
+	uint32_t crc;
+	{
+		ifstream in(path, ios::binary);
+		crc = crc_of(in, filesystem::file_size(path));
+	}
+
+	ofstream out(path, ios::binary | ios::app);
+	out.write(checksum_magic.data(), checksum_magic.size());
+	write_big(out, gtl::vector<uint32_t>{crc});
+	if (!out) throw runtime_error("couldn't write "+path);
+}
+
+//extract saves what its stages produce in extract/, so a rerun (after a crash, or to redo a later stage)
+//skips the stages whose inputs haven't changed. a checkpoint is "WIKICKP1", a stamp of the inputs (the
+//namespace, and each dump's path, size and mtime), the stage's data, then the same checksum as data.bin
+constexpr array<char,8> checkpoint_magic {'W','I','K','I','C','K','P','1'};
+constexpr char const* checkpoint_dir = "./extract";
+
+string checkpoint_stamp(initializer_list<string> dumps) {
+	stringstream ss;
+	ss<<"ns "<<wiki_ns<<"\n";
+	for (auto const& d: dumps)
+		ss<<d<<" "<<filesystem::file_size(d)<<" "<<filesystem::last_write_time(d).time_since_epoch().count()<<"\n";
+	return ss.str();
+}
+
+string checkpoint_path(string const& stage) {
+	return string(checkpoint_dir)+"/"+stage+".ckpt";
+}
+
+template<class F>
+void save_checkpoint(string const& stage, string const& stamp, F write) {
+	string path = checkpoint_path(stage);
+	filesystem::create_directories(checkpoint_dir);
+	{
+		ofstream out(temp_path(path), ios::binary);
+		out.write(checkpoint_magic.data(), checkpoint_magic.size());
+		write_big(out, gtl::vector<uint64_t>{stamp.size()});
+		out<<stamp;
+		write(out);
+		if (!out) throw runtime_error("couldn't write "+path);
+	}
+
+	append_checksum(temp_path(path));
+	replace_file(path);
+	progress("saved ", path, "\n");
+}
+
+//false if there's no intact checkpoint for these inputs, so the stage has to run
+template<class F>
+bool load_checkpoint(string const& stage, string const& stamp, F read) {
+	string path = checkpoint_path(stage);
+	ifstream in(path, ios::binary);
+	if (!in) return false;
+
+	in.seekg(0, ios::end);
+	size_t size=in.tellg();
+	auto crc = read_checksum(in, size);
+	if (!crc) return false;
+
+	//stamp first, it's cheaper
+	in.seekg(0);
+	array<char,8> magic;
+	gtl::vector<uint64_t> stamp_len(1);
+	in.read(magic.data(), magic.size());
+	read_big(in, stamp_len);
+	if (!in || magic!=checkpoint_magic || stamp_len[0]!=stamp.size()) return false;
+
+	string old_stamp(stamp.size(), '\0');
+	in.read(old_stamp.data(), old_stamp.size());
+	if (old_stamp!=stamp) {
+		progress(path, " is for other inputs\n");
+		return false;
+	}
+
+	progress("checking ", path, "\n");
+	in.seekg(0);
+	if (crc_of(in, size)!=*crc) {
+		progress(path, " is corrupt\n");
+		return false;
+	}
+
+	in.seekg(checkpoint_magic.size()+sizeof(uint64_t)+stamp.size());
+	in.exceptions(ios::failbit | ios::badbit);
+	read(in);
+	progress("using ", path, "\n");
+	return true;
+}
+
 struct InMemoryData {
 	int n;
 	gtl::vector<int> buf;
@@ -123,17 +686,210 @@ struct InMemoryData {
 	}
 };
 
+//a whole file mapped read only, data is null if it couldn't be opened or is empty
+struct Mapped {
+	char const* data=nullptr;
+	size_t size=0;
+
+	Mapped(string const& path) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd==-1) return;
+
+		struct stat st;
+		if (fstat(fd, &st)==0 && st.st_size>0) {
+			void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (p!=MAP_FAILED) data=static_cast<char const*>(p), size=st.st_size;
+		}
+
+		//the mapping keeps the file, even if path is replaced
+		close(fd);
+	}
+
+	Mapped(Mapped const&)=delete;
+	~Mapped() {if (data) munmap(const_cast<char*>(data), size);}
+
+	template<class T>
+	T at(size_t off) const {
+		T x;
+		memcpy(&x, data+off, sizeof(T));
+		return convert(x);
+	}
+};
+
+//data.bin: n, then n page ids, the 2n ends of the adj and rev_adj lists, and the lists themselves.
+//optionally followed by n pagerank scores (floats), which make sample() favor popular pages, then the checksum.
+//the file (and data.idx) is mapped and shared between copies, and each copy reads with its own cursor,
+//so concurrent queries each take a copy instead of taking turns
 struct Data {
-	ifstream data;
+	shared_ptr<Mapped const> file, index;
+	size_t pos=0;
+
 	int n;
-	size_t off1, off2, off3;
-	Data(): data("./data.bin", ios::binary) {
-		data.read(reinterpret_cast<char*>(&n), sizeof(int));
-		n=convert(n);
+	size_t off1, off2, off3, off4;
+
+	//alias table over pages weighted by rank, empty without ranks
+	struct Alias {
+		gtl::vector<float> prob;
+		gtl::vector<int> to;
+	};
+
+	shared_ptr<Alias const> alias;
+
+	//data.idx, n_landmark is 0 without one
+	int n_landmark=0;
+
+	//bytes before the checksum, which is nullopt for older files
+	size_t size;
+	optional<uint32_t> checksum;
+
+	Data(string const& path="./data.bin"): file(make_shared<Mapped>(path)), index(make_shared<Mapped>(index_path(path))) {
+		if (!file->data) throw runtime_error("can't open "+path);
+
+		size=file->size;
+		if (size>=checksum_size && equal(checksum_magic.begin(), checksum_magic.end(), file->data+size-checksum_size)) {
+			checksum=file->at<uint32_t>(size-sizeof(uint32_t));
+			size-=checksum_size;
+		}
+
+		if (size<sizeof(int)) throw runtime_error(path+" is truncated");
+		n=file->at<int>(0);
 
 		off1=sizeof(int);
 		off2=off1 + sizeof(int64_t)*n;
 		off3=off2 + sizeof(int)*n*2;
+		off4=off3;
+		if (n>0) {
+			if (size<off3) throw runtime_error(path+" is truncated");
+			off4 += sizeof(int)*size_t(file->at<int>(off2 + sizeof(int)*(2*n-1)));
+		}
+
+		if (size<off4) throw runtime_error(path+" is truncated");
+
+		if (n>0 && size>=off4+sizeof(float)*n) {
+			gtl::vector<float> rank = read_ranks();
+			build_alias(rank);
+		}
+
+		if (index->data && index->size>=index_header+2*sizeof(Profile)*n) {
+			size_t off=index_magic.size();
+			int idx_n=index->at<int>(off), idx_h=index->at<int>(off+=sizeof(int)), idx_landmarks=index->at<int>(off+=sizeof(int));
+			int64_t of_size=index->at<int64_t>(off+=sizeof(int));
+			uint32_t of_checksum=index->at<uint32_t>(off+=sizeof(int64_t));
+
+			//computed from a different data.bin (even one with the same pages) or by another version, ignore it
+			if (equal(index_magic.begin(), index_magic.end(), index->data) && idx_n==n && idx_h==profile_h
+				&& checksum && of_size==int64_t(size) && of_checksum==*checksum) n_landmark=idx_landmarks;
+		}
+	}
+
+	//whether the contents match the checksum. false without one
+	bool verify() const {
+		if (!checksum) return false;
+		return crc32_z(crc32_z(0, nullptr, 0), reinterpret_cast<Bytef const*>(file->data), size)==*checksum;
+	}
+
+	Profile profile(int i, bool rev) const {
+		Profile out;
+		memcpy(&out, index->data + index_header + sizeof(Profile)*(size_t(rev)*n+i), sizeof(Profile));
+		return out;
+	}
+
+	//the best of a few popularity-weighted pages for being lb away from (or, with rev, to) most pages,
+	//so select's bfs rarely starts from a page everything is close to. just sample() without an index
+	int sample_far(minstd_rand& rng, int lb, bool rev) const {
+		int best = sample(rng);
+		if (n_landmark==0 || lb<=1) return best;
+
+		auto score = [&](int i) {
+			Profile p = profile(i, rev);
+			return pair<int,int>(lb<=profile_h ? p.far[lb] : 0, p.ecc);
+		};
+
+		auto best_score = score(best);
+		for (int k=1; k<sample_far_tries; k++) {
+			int i = sample(rng);
+			auto sc = score(i);
+			if (sc>best_score) best=i, best_score=sc;
+		}
+
+		return best;
+	}
+
+	void seek(size_t off) {pos=off;}
+
+	//xs.size() values from the cursor on
+	template<class T>
+	void read_all(gtl::vector<T>& xs) {
+		memcpy(xs.data(), file->data+pos, sizeof(T)*xs.size());
+		for (T& x: xs) x=convert(x);
+		pos+=sizeof(T)*xs.size();
+	}
+
+	gtl::vector<float> read_ranks() {
+		gtl::vector<uint32_t> raw(n);
+		seek(off4);
+		read_all(raw);
+
+		gtl::vector<float> rank(n);
+		for (int i=0; i<n; i++) rank[i]=bit_cast<float>(raw[i]);
+		return rank;
+	}
+
+	//all of adj (or rev_adj) at once
+	Csr read_csr(bool rev) {
+		Csr c;
+		c.end.resize(n);
+		int begin=0;
+		if (rev) {
+			seek(off2+sizeof(int)*(n-1));
+			begin=read();
+		} else {
+			seek(off2);
+		}
+
+		read_all(c.end);
+		for (int& x: c.end) x-=begin;
+
+		c.to.resize(c.end.back());
+		seek(off3+sizeof(int)*begin);
+		read_all(c.to);
+		return c;
+	}
+
+	//vose's method
+	void build_alias(gtl::vector<float> const& weight) {
+		double total=0;
+		for (float w: weight) total+=w;
+
+		Alias a {.prob=gtl::vector<float>(n), .to=gtl::vector<int>(n)};
+
+		gtl::vector<double> scaled(n);
+		gtl::vector<int> small, large;
+		for (int i=0; i<n; i++) {
+			scaled[i] = weight[i]*n/total;
+			(scaled[i]<1 ? small : large).push_back(i);
+		}
+
+		while (small.size() && large.size()) {
+			int s=small.back(), l=large.back();
+			small.pop_back();
+
+			a.prob[s]=scaled[s];
+			a.to[s]=l;
+			scaled[l] -= 1-scaled[s];
+			if (scaled[l]<1) large.pop_back(), small.push_back(l);
+		}
+
+		for (int i: small) a.prob[i]=1, a.to[i]=i;
+		for (int i: large) a.prob[i]=1, a.to[i]=i;
+		alias = make_shared<Alias const>(std::move(a));
+	}
+
+	//random page, by popularity if there are ranks
+	int sample(minstd_rand& rng) const {
+		int i = uniform_int_distribution<>(0,n-1)(rng);
+		if (!alias) return i;
+		return uniform_real_distribution<float>()(rng)<alias->prob[i] ? i : alias->to[i];
 	}
 
 	InMemoryData to_mem() {
@@ -143,42 +899,32 @@ struct Data {
 			.to_id=gtl::vector<int64_t>(n)
 		};
 
-		data.seekg(off1);
-		for (int i=0; i<n; i++) {
-			mem.to_id[i] = read_big();
-		}
+		seek(off1);
+		read_all(mem.to_id);
 
-		for (int i=0; i<2*n; i++) mem.buf[i]=read();
+		read_all(mem.buf);
 		mem.buf.resize(mem.buf.back()+2*n);
 		for (int i=0; i<mem.buf[2*n-1]; i++) mem.buf[2*n+i]=read();
 		return mem;
 	}
 
-	int64_t to_id(int i) {
-		data.seekg(off1 + sizeof(int64_t)*i);
-		return read_big();
-	}
-
-	int read_big() {
-		int64_t out;
-		data.read(reinterpret_cast<char*>(&out), sizeof(int64_t));
-		out=convert(out);
-		return out;
+	int64_t to_id(int i) const {
+		return file->at<int64_t>(off1 + sizeof(int64_t)*i);
 	}
 
 	int read() {
-		int out;
-		data.read(reinterpret_cast<char*>(&out), sizeof(int));
-		out=convert(out);
+		int out = file->at<int>(pos);
+		pos+=sizeof(int);
 		return out;
 	}
 
 	int read_i(int i) {
-		data.seekg(i*sizeof(int), ios::cur);
+		pos+=i*sizeof(int);
 		return read();
 	}
 
-	int from_id(int64_t id) {
+	int from_id(int64_t id) const {
+		STAT_COUNT("wiki.from_id", 1);
 		int i=0;
 		int64_t cur=to_id(i);
 		for (int jmp=bit_floor(unsigned(n)); jmp>0; jmp>>=1) {
@@ -197,20 +943,51 @@ struct Data {
 		int prev;
 		if (i==0) {
 			prev=0;
-			data.seekg(off2+sizeof(int)*i);
+			seek(off2+sizeof(int)*i);
 		} else {
-			data.seekg(off2+sizeof(int)*(i-1));
+			seek(off2+sizeof(int)*(i-1));
 			prev=read();
 		}
 
 		int to_adj=read();
-		if (to_adj>prev) data.seekg(off3+sizeof(int)*prev);
+		if (to_adj>prev) seek(off3+sizeof(int)*prev);
 		return to_adj - prev;
 	}
 };
 
-gtl::vector<int> path_between(Data& d, int p1_i, int p2_i) {
-	gtl::bit_vector visited_a(d.n), visited_b(d.n);
+//pages a query can't go through (for variants like "no country pages"), as a bitset over pages.
+//searches with a visited bitset start it as a copy, so banned pages cost nothing per link
+gtl::bit_vector banned_pages(Data& d, gtl::vector<int64_t> const& ids) {
+	gtl::bit_vector out(d.n);
+	for (int64_t id: ids) {
+		int i = d.from_id(id);
+		if (i!=-1) out.set(i);
+	}
+
+	return out;
+}
+
+//page ids, one per line
+gtl::bit_vector read_banned(Data& d, string const& path) {
+	ifstream in(path);
+	if (!in) throw runtime_error("can't open "+path);
+
+	gtl::vector<int64_t> ids;
+	for (int64_t id; in>>id;) ids.push_back(id);
+	return banned_pages(d, ids);
+}
+
+bool is_banned(gtl::bit_vector const* banned, int i) {
+	return banned && (*banned)[i];
+}
+
+//empty if there's no path, or if cancel gets set (checked between levels). the path avoids banned pages
+gtl::vector<int> path_between(Data& d, int p1_i, int p2_i, atomic<bool> const* cancel=nullptr,
+	gtl::bit_vector const* banned=nullptr) {
+	STAT_TIME("wiki.path_between");
+	if (is_banned(banned, p1_i) || is_banned(banned, p2_i)) return {};
+
+	gtl::bit_vector visited_a = banned ? *banned : gtl::bit_vector(d.n), visited_b = visited_a;
 	gtl::vector<int> qa, qb, nxt_a, nxt_b;
 	gtl::parallel_flat_hash_map<int, int> from;
 
@@ -221,6 +998,8 @@ gtl::vector<int> path_between(Data& d, int p1_i, int p2_i) {
 	visited_b.set(p2_i);
 
 	for (int l=1; qa.size() && qb.size(); l++) {
+		if (cancel && *cancel) return {};
+
 		bool rev = l%2==1;
 		auto& q = rev ? qb : qa;
 		auto& nxt = rev ? nxt_b : nxt_a;
@@ -229,6 +1008,9 @@ gtl::vector<int> path_between(Data& d, int p1_i, int p2_i) {
 
 		for (int v: q) {
 			int adj_l = d.goto_adj(v, rev);
+			STAT_COUNT("wiki.path_between.expanded", 1);
+			STAT_COUNT("wiki.path_between.edges", adj_l);
+
 			while (adj_l--) {
 				int y = d.read();
 				if (visit[y]) continue;
@@ -270,306 +1052,1393 @@ gtl::vector<int> path_between(Data& d, int p1_i, int p2_i) {
 	return {};
 }
 
-int main(int argc, char** argv) {
-	stringstream ss;
-	for (int i=1; i<argc; i++) ss<<argv[i]<<"\n";
+struct PathDag {
+	int distance=-1;
+	uint64_t n_paths=0; //# of shortest paths, saturating
+	gtl::vector<int> width; //# of pages on some shortest path at each position, distance+1 of them
+	gtl::vector<gtl::vector<int>> paths; //sampled shortest paths
+	gtl::vector<gtl::vector<int>> choices; //for each sampled page, # of links it has that stay on a shortest path
+};
 
-	string action;
-	ss>>action;
+uint64_t sat_add(uint64_t a, uint64_t b) {
+	uint64_t out;
+	return __builtin_add_overflow(a,b,&out) ? numeric_limits<uint64_t>::max() : out;
+}
 
-	gtl::parallel_flat_hash_map<string, int64_t> name_id;
-	gtl::parallel_flat_hash_map<int64_t, int64_t> id_to;
-	gtl::parallel_flat_hash_map<int64_t, gtl::vector<int64_t>> redirect_from;
-	gtl::parallel_flat_hash_map<int64_t, int64_t> link_target_id;
+uint64_t sat_mul(uint64_t a, uint64_t b) {
+	uint64_t out;
+	return __builtin_mul_overflow(a,b,&out) ? numeric_limits<uint64_t>::max() : out;
+}
 
-	minstd_rand rng(321);
+//all shortest paths from p1_i to p2_i with one bidirectional bfs that counts the shortest paths to each page it visits.
+//the searches meet at a layer of pages every shortest path goes through once. walking back from there through
+//pages one closer to each end gives the layered dag, and k paths sampled with the counts as weights
+//(uniform unless counts saturate). nullopt if there's no path (avoiding banned pages)
+optional<PathDag> path_dag(Data& d, int p1_i, int p2_i, int k, minstd_rand& rng, gtl::bit_vector const* banned=nullptr) {
+	STAT_TIME("wiki.path_dag");
+	if (is_banned(banned, p1_i) || is_banned(banned, p2_i)) return nullopt;
+
+	struct Seen {
+		int dist;
+		uint64_t count;
+	};
+
+	//side 0 searches forward from p1_i, side 1 backward from p2_i
+	array<gtl::flat_hash_map<int,Seen>,2> seen;
+	array<gtl::vector<int>,2> q {gtl::vector<int>{p1_i}, gtl::vector<int>{p2_i}};
+	seen[0][p1_i] = seen[1][p2_i] = {0,1};
+
+	gtl::vector<int> adj_buf;
+	auto read_adj = [&](int v, bool rev) -> gtl::vector<int> const& {
+		adj_buf.resize(d.goto_adj(v, rev));
+		for (int& y: adj_buf) y=d.read();
+		return adj_buf;
+	};
+
+	int side=-1, distance=-1;
+	gtl::vector<int> meet;
+
+	if (p1_i==p2_i) {
+		side=0, distance=0;
+		meet={p1_i};
+	}
 
-	if (action=="extract") {
-		string pagelinks, page, linktarget, redirects;
-		ss>>pagelinks>>page>>linktarget>>redirects;
-		cout<<"using"<<pagelinks<<" "<<page<<" "<<linktarget<<" "<<redirects<<"\n";
+	for (int l=0; distance==-1; l++) {
+		side=l%2;
+		if (q[0].empty() || q[1].empty()) return nullopt;
+
+		gtl::vector<int> nxt;
+		for (int v: q[side]) {
+			Seen sv = seen[side][v];
+			STAT_COUNT("wiki.path_dag.expanded", 1);
+
+			for (int y: read_adj(v, side==1)) {
+				//the walks back and the samples only use pages seen here
+				if (is_banned(banned, y)) continue;
+				auto [it, inserted] = seen[side].try_emplace(y, Seen {sv.dist+1, 0});
+				if (inserted) nxt.push_back(y);
+				if (it->second.dist==sv.dist+1) it->second.count = sat_add(it->second.count, sv.count);
+			}
+		}
 
-		int64_t cur_id;
-		bool in_ns=false;
+		q[side].swap(nxt);
 
-		gtl::vector<int64_t> id_not_redirect;
+		int best=numeric_limits<int>::max();
+		for (int y: q[side]) {
+			auto it = seen[!side].find(y);
+			if (it!=seen[!side].end()) best=min(best, it->second.dist);
+		}
 
-		ifstream page_in(page);
-		parse(page_in, [&](Value& v, int rec_i) {
-			if (rec_i==3 && in_ns) {
-				if (!get<int64_t>(v)) id_not_redirect.push_back(cur_id);
-			} else if (rec_i==2 && in_ns) {
-				name_id.emplace(std::move(get<string>(v)), cur_id);
-			} else if (rec_i==1) {
-				in_ns=get<int64_t>(v)==wiki_ns;
-			} else if (rec_i==0) {
-				cur_id = get<int64_t>(v);
-			}
-		});
+		if (best==numeric_limits<int>::max()) continue;
 
-		cout<<"done with pages\n";
-		cout<<name_id.size()<<" total, "<<id_not_redirect.size()<<" are not redirects\n";
-		sort(id_not_redirect.begin(), id_not_redirect.end());
-		cout<<"sorted ids\n";
-
-		cout<<"id for Freguesia is "<<name_id["Freguesia"]<<"\n";
-
-		cout<<"reading redirects...\n";
-		ifstream redirects_in(redirects);
-		parse(redirects_in, [&](Value& v, int rec_i) {
-			if (rec_i==0) cur_id=get<int64_t>(v);
-			else if (rec_i==1) in_ns=get<int64_t>(v)==wiki_ns;
-			else if (rec_i==2 && in_ns) {
-				auto it = name_id.find(get<string>(v));
-				if (it!=name_id.end()) {
-					redirect_from[it->second].push_back(cur_id);
-				}
-			}
-		});
+		distance = seen[side][q[side][0]].dist+best;
+		for (int y: q[side]) {
+			auto it = seen[!side].find(y);
+			if (it!=seen[!side].end() && it->second.dist==best) meet.push_back(y);
+		}
+	}
 
-		cout<<"DFSing redirects...\n";
-		vector<int64_t> stack;
-		for (int64_t id: id_not_redirect) {
-			stack.push_back(id);
-			id_to[id]=id;
-			while (stack.size()) {
-				auto it = redirect_from.find(stack.back());
-				stack.pop_back();
-
-				if (it!=redirect_from.end()) {
-					for (int64_t y: it->second) {
-						auto to = id_to.find(y);
-						if (to==id_to.end()) {
-							id_to[y]=id;
-							stack.push_back(y);
-						}
-					}
+	PathDag out;
+	out.distance=distance;
+	int meet_pos = side==0 ? seen[0][meet[0]].dist : distance-seen[1][meet[0]].dist;
+
+	//pages at each position, going from the meeting layer towards both ends through pages one closer to that end
+	gtl::vector<gtl::flat_hash_set<int>> layer(distance+1);
+	layer[meet_pos].insert(meet.begin(), meet.end());
+
+	for (int s: {0,1}) {
+		int dir = s==0 ? -1 : 1;
+		for (int pos=meet_pos; pos!=(s==0 ? 0 : distance); pos+=dir) {
+			for (int v: layer[pos]) {
+				int dist = seen[s][v].dist;
+				//back along the search, against the direction it went
+				for (int u: read_adj(v, s==0)) {
+					auto it = seen[s].find(u);
+					if (it!=seen[s].end() && it->second.dist==dist-1) layer[pos+dir].insert(u);
 				}
 			}
 		}
+	}
 
-		redirect_from={};
+	for (auto const& x: layer) out.width.push_back(x.size());
 
-		cout<<"handling link targets\n";
-		gtl::parallel_flat_hash_map<int64_t,int> id_not_redirect_map;
-		for (int i=0; i<id_not_redirect.size(); i++)
-			id_not_redirect_map.emplace(id_not_redirect[i], i);
-
-		cout<<"index of freguesia is "<<id_not_redirect_map[name_id["Freguesia"]]<<"\n";
-
-		ifstream link_in(linktarget);
-		parse(link_in, [&](Value& v, int rec_i) {
-			if (rec_i==0) cur_id=get<int64_t>(v);
-			else if (rec_i==1) in_ns=get<int64_t>(v)==wiki_ns;
-			else if (rec_i==2 && in_ns) {
-				auto it = name_id.find(get<string>(v));
-				if (it==name_id.end()) return;
-				auto it2 = id_to.find(it->second);
-				if (it2==id_to.end()) return;
-
-				link_target_id.emplace(cur_id, it2->second);
-			}
-		});
+	gtl::vector<double> meet_w;
+	for (int m: meet) {
+		uint64_t c = sat_mul(seen[0][m].count, seen[1][m].count);
+		out.n_paths = sat_add(out.n_paths, c);
+		meet_w.push_back(c);
+	}
 
-		cout<<"done with link targets\n";
-		cout<<link_target_id.size()<<" targets\n";
+	gtl::vector<int> cand;
+	gtl::vector<double> cand_w;
+	for (int i=0; i<k; i++) {
+		gtl::vector<int> path(distance+1);
+		path[meet_pos] = meet[discrete_distribution<int>(meet_w.begin(), meet_w.end())(rng)];
+
+		for (int s: {0,1}) {
+			int dir = s==0 ? -1 : 1;
+			for (int pos=meet_pos; pos!=(s==0 ? 0 : distance); pos+=dir) {
+				cand.clear(), cand_w.clear();
+				for (int u: read_adj(path[pos], s==0)) {
+					if (layer[pos+dir].contains(u)) cand.push_back(u), cand_w.push_back(seen[s][u].count);
+				}
+
+				path[pos+dir] = cand[discrete_distribution<int>(cand_w.begin(), cand_w.end())(rng)];
+			}
+		}
+
+		gtl::vector<int> choices(distance+1);
+		for (int pos=0; pos<distance; pos++) {
+			for (int y: read_adj(path[pos], false)) choices[pos]+=layer[pos+1].contains(y);
+		}
+
+		out.paths.push_back(std::move(path));
+		out.choices.push_back(std::move(choices));
+	}
+
+	return out;
+}
+
+//a backward bfs from the target reaches most of the graph before it finds anything far away,
+//so it only beats a bidirectional search per source with this many sources (see BM_DistancesTo)
+constexpr int min_batch_bfs = 1024;
+
+//distance from each source to target avoiding banned pages, -1 where there's no path
+//false if cancel got set (checked between levels)
+bool distances_to(Data& d, gtl::vector<int> const& sources, int target, gtl::vector<int>& out,
+	atomic<bool> const* cancel=nullptr, gtl::bit_vector const* banned=nullptr) {
+	STAT_TIME("wiki.distances_to");
+	STAT_COUNT("wiki.distances_to.sources", sources.size());
+
+	out.assign(sources.size(), -1);
+
+	//source -> indices in sources that want it
+	gtl::flat_hash_map<int, gtl::vector<int>> want;
+	for (int i=0; i<sources.size(); i++) want[sources[i]].push_back(i);
+
+	if (want.size()<min_batch_bfs) {
+		for (auto& [s, idx]: want) {
+			if (cancel && *cancel) return false;
+
+			int dist=0;
+			if (s!=target) {
+				auto path = path_between(d, s, target, cancel, banned);
+				if (cancel && *cancel) return false;
+				dist = int(path.size())-1;
+			}
+
+			for (int i: idx) out[i]=dist;
+		}
+
+		return true;
+	}
+
+	STAT_COUNT("wiki.distances_to.batch_bfs", 1);
+	if (is_banned(banned, target)) return true;
+
+	gtl::bit_vector visited = banned ? *banned : gtl::bit_vector(d.n);
+	gtl::vector<int> q={target}, nxt;
+	visited.set(target);
+
+	int n_left=want.size();
+	for (int l=0; q.size() && n_left>0; l++) {
+		if (cancel && *cancel) return false;
+
+		for (int v: q) {
+			auto it = want.find(v);
+			if (it!=want.end()) {
+				for (int i: it->second) out[i]=l;
+				n_left--;
+			}
+		}
+
+		if (n_left==0) break;
+
+		for (int v: q) {
+			int adj_l = d.goto_adj(v, true);
+			STAT_COUNT("wiki.distances_to.expanded", 1);
+			STAT_COUNT("wiki.distances_to.edges", adj_l);
+
+			while (adj_l--) {
+				int y = d.read();
+				if (visited[y]) continue;
+				visited.set(y);
+				nxt.push_back(y);
+			}
+		}
+
+		q.swap(nxt);
+		nxt.clear();
+	}
+
+	return true;
+}
 
-		name_id={};
+struct Selection {
+	int distance, source, target;
+};
 
-		ifstream pagelinks_in(pagelinks);
-		gtl::parallel_flat_hash_map<int64_t, gtl::flat_hash_set<int64_t>> links_map;
-		parse(pagelinks_in, [&](Value& v, int rec_i) {
-			if (rec_i==0) cur_id=get<int64_t>(v);
-			else if (rec_i==2) {
-				if (!id_not_redirect_map.contains(cur_id)) return;
+//random pair of pages at least lb apart (any connected pair if lb<=0), nullopt if none was found in time.
+//neither is banned, and the distance is the one avoiding banned pages
+optional<Selection> select(Data& d, int lb, minstd_rand& rng, gtl::bit_vector const* banned=nullptr) {
+	STAT_TIME("wiki.select");
+	if (lb<=0) {
+		for (int at=0; at<50; at++) {
+			int s,t;
+			for (int* x: {&s,&t}) *x=d.sample(rng);
+
+			auto path = path_between(d, s, t, nullptr, banned);
+			if (!path.empty()) return Selection {int(path.size())-1, s, t};
+		}
 
-				auto it = link_target_id.find(get<int64_t>(v));
-				if (it!=link_target_id.end()) {
-					links_map[cur_id].insert(it->second);
+		return nullopt;
+	}
+	
+	gtl::parallel_flat_hash_map<int, gtl::vector<array<int,2>>> visited;
+	gtl::vector<int> a,b;
+	gtl::parallel_flat_hash_set<int> visited_2;
+	gtl::vector<int> sources;
+	optional<Selection> out;
+
+	auto add_source = [&]() -> bool {
+		STAT_COUNT("wiki.select.sources", 1);
+		int source = d.sample_far(rng, lb, false);
+		if (is_banned(banned, source)) return false;
+		int source_i=sources.size();
+		sources.push_back(source);
+
+		a={source};
+		visited_2={source};
+		visited[source].push_back(array<int,2>{source_i,0});
+
+		int l1=1;
+		for (; visited_2.size()<1e3 && a.size(); l1++) {
+			for (int x: a) {
+				int v = d.goto_adj(x, false);
+				while (v--) {
+					int y = d.read();
+					if (!is_banned(banned, y) && !visited_2.contains(y)) {
+						b.push_back(y);
+						visited_2.insert(y);
+						visited[y].push_back(array<int,2>{source_i,l1});
+
+						if (l1>=lb) {
+							out = Selection {l1, source, y};
+							return true;
+						}
+					}
 				}
 			}
-		});
 
-		cout<<"done with page links\n";
-		cout<<links_map.size()<<" sources\n";
+			a.swap(b);
+			b.clear();
+		}
 
-		ofstream data("./data.bin", ios::binary);
+		return false;
+	};
+
+	gtl::vector<int> bad;
+	auto add_target = [&]() -> bool {
+		STAT_COUNT("wiki.select.targets", 1);
+		int n_bad;
+		bad.assign(sources.size(), 0);
+
+		int target = d.sample_far(rng, lb, true);
+		if (is_banned(banned, target) || visited.contains(target)) return false;
+
+		a={target};
+
+		n_bad=0;
+		visited_2.clear();
+		visited_2.insert(target);
+
+		for (int l=1; n_bad<sources.size() && a.size(); l++) {
+			for (int x: a) {
+				int v = d.goto_adj(x, true);
+				while (v--) {
+					int y = d.read();
+					if (is_banned(banned, y)) continue;
+
+					auto it = visited.find(y);
+					if (it!=visited.end()) {
+						for (auto [source_i, l1]: it->second) {
+							if (bad[source_i]) continue;
+							if (l+l1<lb) {
+								bad[source_i]=1; n_bad++;
+							} else {
+								out = Selection {l+l1, sources[source_i], target};
+								return true;
+							}
+						}
+					}
+					
+					if (!visited_2.contains(y)) {
+						b.push_back(y);
+						visited_2.insert(y);
+					}
+				}
 
-		auto write_int = [&data](int x) {
-			x=convert(x);
-			data.write(reinterpret_cast<char*>(&x), sizeof(int));
-		};
+				if (n_bad>=sources.size()) break;
+			}
 
-		auto write_int64 = [&data](int64_t x) {
-			x=convert(x);
-			data.write(reinterpret_cast<char*>(&x), sizeof(int64_t));
-		};
+			a.swap(b);
+			b.clear();
+		}
+	
+		return false;
+	};
 
-		write_int(id_not_redirect.size());
+	for (int i=0; i<100; i++) {
+		if (add_source() || add_target() || add_target()) return out;
+	}
 
-		cout<<"writing ids\n";
-		for (int64_t id: id_not_redirect) write_int64(id);
+	return nullopt;
+}
 
-		cout<<"computing adj lists\n";
+//just enough json for the html dumps. values the caller doesn't read are skipped
+struct JsonReader {
+	string_view s;
+	size_t i=0;
 
-		gtl::vector<gtl::vector<int>> adj(id_not_redirect.size());
-		gtl::vector<gtl::vector<int>> rev_adj(id_not_redirect.size());
+	char peek() {
+		while (i<s.size() && isspace(uint8_t(s[i]))) i++;
+		if (i>=s.size()) throw runtime_error("unexpected end of json");
+		return s[i];
+	}
+
+	void expect(char c) {
+		if (peek()!=c) throw runtime_error(string("expected ")+c+" in json");
+		i++;
+	}
 
-		for (int i=0; i<id_not_redirect.size(); i++) {
-			auto it = links_map.find(id_not_redirect[i]);
-			if (it!=links_map.end()) {
-				for (int64_t y: it->second) {
-					int to = id_not_redirect_map.find(y)->second;
-					rev_adj[to].push_back(i);
-					adj[i].push_back(to);
+	char next() {
+		if (i>=s.size()) throw runtime_error("unexpected end of json");
+		return s[i++];
+	}
+
+	uint32_t hex4() {
+		uint32_t out=0;
+		for (int k=0; k<4; k++) {
+			char c=next();
+			out = out*16 + (isdigit(uint8_t(c)) ? c-'0' : (tolower(c)-'a'+10));
+		}
+
+		return out;
+	}
+
+	static void put_utf8(string& out, uint32_t c) {
+		if (c<0x80) out.push_back(c);
+		else if (c<0x800) out.push_back(0xc0|c>>6), out.push_back(0x80|(c&0x3f));
+		else if (c<0x10000) out.push_back(0xe0|c>>12), out.push_back(0x80|(c>>6&0x3f)), out.push_back(0x80|(c&0x3f));
+		else {
+			out.push_back(0xf0|c>>18), out.push_back(0x80|(c>>12&0x3f));
+			out.push_back(0x80|(c>>6&0x3f)), out.push_back(0x80|(c&0x3f));
+		}
+	}
+
+	//null out skips the string
+	void str(string* out) {
+		expect('"');
+		while (true) {
+			char c=next();
+			if (c=='"') return;
+			if (c!='\\') {
+				if (out) out->push_back(c);
+				continue;
+			}
+
+			char e=next();
+			if (!out) {
+				if (e=='u') hex4();
+				continue;
+			}
+
+			switch (e) {
+				case 'n': out->push_back('\n'); break;
+				case 't': out->push_back('\t'); break;
+				case 'r': out->push_back('\r'); break;
+				case 'b': out->push_back('\b'); break;
+				case 'f': out->push_back('\f'); break;
+				case 'u': {
+					uint32_t c1=hex4();
+					//surrogate pair
+					if (c1>=0xd800 && c1<0xdc00 && s.substr(i,2)=="\\u") {
+						i+=2;
+						c1 = 0x10000 + ((c1-0xd800)<<10) + (hex4()-0xdc00);
+					}
+
+					put_utf8(*out, c1);
+					break;
 				}
+				default: out->push_back(e);
 			}
 		}
+	}
 
-		cout<<"writing adj list indices\n";
-		int cur=0;
-		for (int i=0; i<id_not_redirect.size(); i++) {
-			cur+=adj[i].size();
-			write_int(cur);
+	string str() {
+		string out;
+		str(&out);
+		return out;
+	}
+
+	int64_t integer() {
+		peek();
+		int64_t out=0;
+		auto res = from_chars(s.data()+i, s.data()+s.size(), out);
+		if (res.ec!=errc()) throw runtime_error("expected a number in json");
+		i = res.ptr-s.data();
+		return out;
+	}
+
+	template<class F>
+	void object(F f) {
+		expect('{');
+		if (peek()=='}') {i++; return;}
+
+		while (true) {
+			string key=str();
+			expect(':');
+			f(key);
+
+			if (peek()==',') i++;
+			else {expect('}'); return;}
 		}
+	}
+
+	template<class F>
+	void array(F f) {
+		expect('[');
+		if (peek()==']') {i++; return;}
 
-		for (int i=0; i<id_not_redirect.size(); i++) {
-			cur+=rev_adj[i].size();
-			write_int(cur);
+		while (true) {
+			f();
+			if (peek()==',') i++;
+			else {expect(']'); return;}
 		}
+	}
 
-		cout<<"total at "<<cur<<"\n";
-		cout<<"writing adj lists\n";
+	void skip() {
+		char c=peek();
+		if (c=='"') str(nullptr);
+		else if (c=='{') object([&](string const&) {skip();});
+		else if (c=='[') array([&]() {skip();});
+		else while (i<s.size() && !strchr(",}] \t\r\n", s[i])) i++;
+	}
+};
+
+void print_json_str(ostream& os, string_view x) {
+	os<<'"';
+	for (char c: x) {
+		if (c=='"' || c=='\\') os<<'\\'<<c;
+		else if (c=='\n') os<<"\\n";
+		else if (uint8_t(c)<0x20) os<<"\\u00"<<"0123456789abcdef"[c>>4]<<"0123456789abcdef"[c&15];
+		else os<<c;
+	}
+
+	os<<'"';
+}
+
+struct Section {
+	int toclevel;
+	string anchor, line;
+};
+
+struct StoredPage {
+	string title;
+	gtl::vector<Section> sections={};
+	string html="";
+};
+
+//like the parse api's parse object
+void print_page_json(ostream& os, int64_t id, StoredPage const& page) {
+	os<<"{\"title\":";
+	print_json_str(os, page.title);
+	os<<",\"pageid\":"<<id<<",\"text\":";
+	print_json_str(os, page.html);
+	os<<",\"sections\":[";
+	for (size_t i=0; i<page.sections.size(); i++) {
+		auto const& sec = page.sections[i];
+		os<<(i ? "," : "")<<"{\"toclevel\":"<<sec.toclevel<<",\"anchor\":";
+		print_json_str(os, sec.anchor);
+		os<<",\"line\":";
+		print_json_str(os, sec.line);
+		os<<"}";
+	}
+
+	os<<"]}";
+}
+
+//parsoid's html from the dumps, made to look like what the parse api gives: the body in a mw-parser-output div,
+//links to /wiki/ instead of ./ (which the client looks for), and sections from the h2-h6 headings
+StoredPage from_parsoid(string title, string_view html) {
+	size_t body = html.find("<body");
+	if (body!=string_view::npos) {
+		body = html.find('>', body);
+		size_t end = html.rfind("</body>");
+		if (body!=string_view::npos && end!=string_view::npos && end>body) html = html.substr(body+1, end-body-1);
+	}
+
+	StoredPage out {.title=std::move(title)};
+	out.html = "<div class=\"mw-parser-output\">";
+	constexpr string_view rel_link="href=\"./", wiki_link="href=\"/wiki/";
+	for (size_t i=0; i<html.size();) {
+		size_t j = html.find(rel_link, i);
+		if (j==string_view::npos) j=html.size();
+		out.html.append(html.substr(i, j-i));
+		if (j<html.size()) out.html.append(wiki_link);
+		i = j+rel_link.size();
+	}
+
+	out.html += "</div>";
+
+	string_view h = out.html;
+	for (size_t i=h.find("<h"); i!=string_view::npos; i=h.find("<h", i+1)) {
+		if (i+3>=h.size() || h[i+2]<'2' || h[i+2]>'6' || (h[i+3]!=' ' && h[i+3]!='>')) continue;
+
+		size_t tag_end = h.find('>', i);
+		size_t close = h.find(string("</h")+h[i+2]+">", i);
+		if (tag_end==string_view::npos || close==string_view::npos || close<tag_end) continue;
+
+		string_view tag = h.substr(i, tag_end-i);
+		size_t id = tag.find(" id=\"");
+		if (id==string_view::npos) continue;
+		size_t id_end = tag.find('"', id+5);
+		if (id_end==string_view::npos) continue;
+
+		out.sections.push_back(Section {
+			.toclevel=h[i+2]-'1',
+			.anchor=string(tag.substr(id+5, id_end-id-5)),
+			.line=string(h.substr(tag_end+1, close-tag_end-1))
+		});
+	}
+
+	return out;
+}
+
+//titles are looked up like the api does: underscores are spaces and the first letter is capitalized
+string title_key(string_view title) {
+	string out(title);
+	for (size_t i=0; i<out.size(); i++) out[i] = out[i]=='_' ? ' ' : i==0 ? toupper(out[i]) : out[i];
+	return out;
+}
+
+//of a title_key
+uint64_t title_hash(string_view key) {
+	uint64_t out=0xcbf29ce484222325; //fnv-1a
+	for (char c: key) out = (out^uint8_t(c))*0x100000001b3;
+	return out;
+}
+
+//pages.bin: "WIKISTO2", n, the dictionary size, the # of titles and where the index starts, then the zstd dictionary,
+//every page's record compressed with it, and the index: the n page ids of data.bin, each page's offset from the
+//first record and compressed size (0 if it's not in the store), then title hashes (sorted, including redirects),
+//their pages, and the title_keys themselves as # of titles + 1 offsets followed by the characters, so a hash
+//collision can't serve the wrong page. all big endian
+//a record is the title, the # of sections, each section's toclevel, anchor and line, then the html.
+//strings are prefixed by their length
+constexpr array<char,8> store_magic {'W','I','K','I','S','T','O','2'};
+constexpr size_t store_header = sizeof(store_magic) + sizeof(int) + 3*sizeof(uint64_t);
+
+string encode_page(StoredPage const& page) {
+	string out;
+	auto put_int = [&](uint32_t x) {
+		x=convert(x);
+		out.append(reinterpret_cast<char*>(&x), sizeof(x));
+	};
+
+	auto put_str = [&](string const& x) {put_int(x.size()); out+=x;};
+
+	put_str(page.title);
+	put_int(page.sections.size());
+	for (auto const& sec: page.sections) {
+		put_int(sec.toclevel);
+		put_str(sec.anchor);
+		put_str(sec.line);
+	}
+
+	out+=page.html;
+	return out;
+}
+
+StoredPage decode_page(string_view x) {
+	auto get_int = [&]() {
+		uint32_t out;
+		if (x.size()<sizeof(out)) throw runtime_error("bad page record");
+		memcpy(&out, x.data(), sizeof(out));
+		x.remove_prefix(sizeof(out));
+		return convert(out);
+	};
+
+	auto get_str = [&]() {
+		uint32_t len=get_int();
+		if (x.size()<len) throw runtime_error("bad page record");
+		string out(x.substr(0,len));
+		x.remove_prefix(len);
+		return out;
+	};
+
+	StoredPage out;
+	out.title=get_str();
+	out.sections.resize(get_int());
+	for (auto& sec: out.sections) {
+		sec.toclevel=get_int();
+		sec.anchor=get_str();
+		sec.line=get_str();
+	}
+
+	out.html=x;
+	return out;
+}
+
+//pages to sample for the dictionary, then how many are compressed together
+constexpr int store_dict_samples = 4096, store_batch = 512;
+constexpr size_t store_dict_size = 112640;
+constexpr int store_level = 12;
+
+//reads an html dump (enterprise ndjson, see from_parsoid) and writes the pages it has out of ids (data.bin's)
+//to out_path. dictionary training and compression run in parallel
+void build_store(string const& dump_path, gtl::vector<int64_t> const& ids, string const& out_path) {
+	int n=ids.size();
+	DumpBuf dump(dump_path);
+	istream in(&dump);
+	in.exceptions(ios::badbit);
+
+	ofstream out(out_path, ios::binary);
+	out.write(string(store_header, '\0').data(), store_header);
+
+	gtl::vector<uint64_t> offset(n);
+	gtl::vector<uint32_t> size(n);
+	//(hash, page) and the title_key of each
+	gtl::vector<pair<uint64_t,int>> titles;
+	gtl::vector<string> title_keys;
+	uint64_t blob_size=0;
+
+	string dict;
+	unique_ptr<ZSTD_CDict, decltype(&ZSTD_freeCDict)> cdict(nullptr, ZSTD_freeCDict);
+
+	struct Pending {
+		int i;
+		string raw;
+	};
+
+	gtl::vector<Pending> batch;
+
+	auto train = [&]() {
+		string samples;
+		gtl::vector<size_t> sizes;
+		for (auto const& p: batch) samples+=p.raw, sizes.push_back(p.raw.size());
+
+		dict.resize(store_dict_size);
+		size_t res = sizes.empty() ? 0 : ZDICT_trainFromBuffer(dict.data(), dict.size(), samples.data(), sizes.data(), sizes.size());
+		//too few samples, go without
+		if (sizes.empty() || ZDICT_isError(res)) res=0;
+		dict.resize(res);
+
+		cdict.reset(ZSTD_createCDict(dict.data(), dict.size(), store_level));
+		if (!cdict) throw runtime_error("ZSTD_createCDict failed");
+		out.write(dict.data(), dict.size());
+		progress("trained a ", dict.size(), " byte dictionary\n");
+	};
+
+	auto flush = [&]() {
+		if (!cdict) train();
+
+		gtl::vector<string> comp(batch.size());
+		parallel_for(batch.size(), [&](size_t l, size_t r) {
+			unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+			for (size_t i=l; i<r; i++) {
+				auto const& raw = batch[i].raw;
+				comp[i].resize(ZSTD_compressBound(raw.size()));
+				size_t res = ZSTD_compress_usingCDict(cctx.get(), comp[i].data(), comp[i].size(), raw.data(), raw.size(), cdict.get());
+				if (ZSTD_isError(res)) throw runtime_error(string("zstd: ")+ZSTD_getErrorName(res));
+				comp[i].resize(res);
+			}
+		});
+
+		for (size_t i=0; i<batch.size(); i++) {
+			offset[batch[i].i]=blob_size;
+			size[batch[i].i]=comp[i].size();
+			out.write(comp[i].data(), comp[i].size());
+			blob_size+=comp[i].size();
+		}
+
+		batch.clear();
+	};
+
+	string line;
+	size_t n_pages=0;
+	while (getline(in, line)) {
+		JsonReader json {line};
+		string name, html;
+		int64_t id=-1, ns=-1;
+		gtl::vector<string> redirects;
+
+		json.object([&](string const& key) {
+			if (key=="name") name=json.str();
+			else if (key=="identifier") id=json.integer();
+			else if (key=="namespace") json.object([&](string const& k) {
+				if (k=="identifier") ns=json.integer();
+				else json.skip();
+			});
+			else if (key=="redirects") json.array([&]() {
+				json.object([&](string const& k) {
+					if (k=="name") redirects.push_back(json.str());
+					else json.skip();
+				});
+			});
+			else if (key=="article_body") json.object([&](string const& k) {
+				if (k=="html") html=json.str();
+				else json.skip();
+			});
+			else json.skip();
+		});
+
+		if (ns!=wiki_ns || html.empty()) continue;
+		auto it = lower_bound(ids.begin(), ids.end(), id);
+		if (it==ids.end() || *it!=id) continue;
+
+		int i = it-ids.begin();
+		title_keys.push_back(title_key(name));
+		for (auto const& r: redirects) title_keys.push_back(title_key(r));
+		while (titles.size()<title_keys.size()) titles.emplace_back(title_hash(title_keys[titles.size()]), i);
+
+		batch.push_back(Pending {i, encode_page(from_parsoid(std::move(name), html))});
+		if (batch.size()>=(cdict ? store_batch : store_dict_samples)) flush();
+
+		if (++n_pages%10000==0) progress("stored ", n_pages, " pages\n");
+	}
 
-		for (int i=0; i<id_not_redirect.size(); i++) {
-			for (int y: adj[i]) write_int(y);
+	if (batch.size() || !cdict) flush();
+	progress("stored ", n_pages, " pages, ", blob_size, " bytes compressed\n");
+
+	gtl::vector<size_t> order(titles.size());
+	for (size_t k=0; k<order.size(); k++) order[k]=k;
+	sort(order.begin(), order.end(), [&](size_t a, size_t b) {return titles[a]<titles[b];});
+
+	gtl::vector<uint64_t> title_hashes, key_offset {0};
+	gtl::vector<int> title_pages;
+	string keys;
+	for (size_t k: order) {
+		title_hashes.push_back(titles[k].first), title_pages.push_back(titles[k].second);
+		keys+=title_keys[k];
+		key_offset.push_back(keys.size());
+	}
+
+	uint64_t index_off = store_header+dict.size()+blob_size;
+	write_big(out, ids);
+	write_big(out, offset);
+	write_big(out, size);
+	write_big(out, title_hashes);
+	write_big(out, title_pages);
+	write_big(out, key_offset);
+	out.write(keys.data(), keys.size());
+
+	out.seekp(0);
+	out.write(store_magic.data(), store_magic.size());
+	write_big(out, gtl::vector<int>{n});
+	write_big(out, gtl::vector<uint64_t>{dict.size(), titles.size(), index_off});
+	if (!out) throw runtime_error("couldn't write "+out_path);
+}
+
+//a pages.bin from build_store, mapped
+struct PageStore {
+	int fd;
+	char const* data=nullptr;
+	size_t size=0;
+
+	int n;
+	size_t n_titles, dict_off, blob_off, ids_off, offset_off, size_off, hash_off, title_page_off, key_offset_off, key_off;
+	unique_ptr<ZSTD_DDict, decltype(&ZSTD_freeDDict)> ddict {nullptr, ZSTD_freeDDict};
+	unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx {ZSTD_createDCtx(), ZSTD_freeDCtx};
+
+	template<class T>
+	T at(size_t off) const {
+		T x;
+		memcpy(&x, data+off, sizeof(T));
+		return convert(x);
+	}
+
+	PageStore(string const& path) {
+		fd = open(path.c_str(), O_RDONLY);
+		if (fd==-1) throw runtime_error("can't open "+path);
+
+		struct stat st;
+		if (fstat(fd, &st)==0) size=st.st_size;
+		if (size>0) {
+			void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+			if (p==MAP_FAILED) size=0;
+			else data=static_cast<char const*>(p);
 		}
 
-		for (int i=0; i<id_not_redirect.size(); i++) {
-			for (int y: rev_adj[i]) write_int(y);
+		if (size<store_header || memcmp(data, store_magic.data(), store_magic.size())!=0) {
+			unmap();
+			throw runtime_error(path+" isn't a page store");
 		}
 
-		cout<<"exiting...\n";
-	} else if (action=="select") {
-		Data d;
-		int lb; ss>>lb;
+		size_t off = store_magic.size();
+		n = at<int>(off);
+		uint64_t dict_size = at<uint64_t>(off+=sizeof(int));
+		n_titles = at<uint64_t>(off+=sizeof(uint64_t));
+		ids_off = at<uint64_t>(off+=sizeof(uint64_t));
+
+		dict_off = store_header;
+		blob_off = dict_off+dict_size;
+		offset_off = ids_off + sizeof(int64_t)*n;
+		size_off = offset_off + sizeof(uint64_t)*n;
+		hash_off = size_off + sizeof(uint32_t)*n;
+		title_page_off = hash_off + sizeof(uint64_t)*n_titles;
+		key_offset_off = title_page_off + sizeof(int)*n_titles;
+		key_off = key_offset_off + sizeof(uint64_t)*(n_titles+1);
+
+		if (key_off>size || key_off + at<uint64_t>(key_offset_off+sizeof(uint64_t)*n_titles) != size) {
+			unmap();
+			throw runtime_error(path+" is truncated");
+		}
+
+		ddict.reset(ZSTD_createDDict(data+dict_off, dict_size));
+		if (!ddict || !dctx) {
+			unmap();
+			throw runtime_error("couldn't set up zstd");
+		}
+	}
+
+	void unmap() {
+		if (data) munmap(const_cast<char*>(data), size);
+		close(fd);
+	}
+
+	~PageStore() {unmap();}
+
+	int64_t id(int i) const {return at<int64_t>(ids_off+sizeof(int64_t)*i);}
+
+	int find_id(int64_t x) const {
+		int lo=0, hi=n;
+		while (lo<hi) {
+			int mid=(lo+hi)/2;
+			if (id(mid)<x) lo=mid+1;
+			else hi=mid;
+		}
+
+		return lo<n && id(lo)==x ? lo : -1;
+	}
+
+	int find_title(string_view title) const {
+		string key = title_key(title);
+		uint64_t hash = title_hash(key);
+		size_t lo=0, hi=n_titles;
+		while (lo<hi) {
+			size_t mid=(lo+hi)/2;
+			if (at<uint64_t>(hash_off+sizeof(uint64_t)*mid)<hash) lo=mid+1;
+			else hi=mid;
+		}
+
+		for (; lo<n_titles && at<uint64_t>(hash_off+sizeof(uint64_t)*lo)==hash; lo++) {
+			uint64_t begin = at<uint64_t>(key_offset_off+sizeof(uint64_t)*lo), end = at<uint64_t>(key_offset_off+sizeof(uint64_t)*(lo+1));
+			if (string_view(data+key_off+begin, end-begin)==key) return at<int>(title_page_off+sizeof(int)*lo);
+		}
+
+		return -1;
+	}
+
+	//nullopt if page i isn't stored. uses one zstd context, so calls take turns
+	optional<StoredPage> get(int i) {
+		if (i<0 || i>=n) return nullopt;
+		uint32_t len = at<uint32_t>(size_off+sizeof(uint32_t)*i);
+		if (len==0) return nullopt;
+
+		char const* src = data+blob_off+at<uint64_t>(offset_off+sizeof(uint64_t)*i);
+		unsigned long long raw_len = ZSTD_getFrameContentSize(src, len);
+		if (raw_len==ZSTD_CONTENTSIZE_ERROR || raw_len==ZSTD_CONTENTSIZE_UNKNOWN) throw runtime_error("bad page record");
+
+		string raw(raw_len, '\0');
+		size_t res = ZSTD_decompress_usingDDict(dctx.get(), raw.data(), raw.size(), src, len, ddict.get());
+		if (ZSTD_isError(res)) throw runtime_error(string("zstd: ")+ZSTD_getErrorName(res));
+		return decode_page(raw);
+	}
+};
+
+//benchmarks include this file for Data, path_between and select
+#ifndef WIKI_NO_MAIN
+int main(int argc, char** argv) {
+	report_stats_on_exit();
+
+	stringstream ss;
+	for (int i=1; i<argc; i++) ss<<argv[i]<<"\n";
 
-		if (lb<=0) {
-			for (int at=0; at<50; at++) {
-				int s,t;
-				for (int* x: {&s,&t}) *x=uniform_int_distribution<>(0,d.n-1)(rng);
+	string action;
+	ss>>action;
+
+	minstd_rand rng(321);
 
-				auto path = path_between(d, s, t);
-				if (!path.empty()) {
-					cout<<path.size()-1<<"\n";
-					cout<<d.to_id(s)<<"\n"<<d.to_id(t)<<"\n";
-					return 0;
+	if (action=="extract") {
+		string pagelinks, page, linktarget, redirects;
+		ss>>pagelinks>>page>>linktarget>>redirects;
+		cout<<"using"<<pagelinks<<" "<<page<<" "<<linktarget<<" "<<redirects<<"\n";
+
+		//the dumps are parsed at the same time into raw rows, without resolving anything, and titles/ids are
+		//resolved afterwards. pagelinks is by far the largest, so everything else (including resolving
+		//redirects and link targets) happens on another thread while it's read
+		gtl::parallel_flat_hash_map<string, int64_t> name_id;
+		gtl::vector<int64_t> id_not_redirect;
+		gtl::vector<pair<int64_t,string>> redirect_rows, linktarget_rows;
+		gtl::vector<array<int64_t,2>> pagelinks_rows;
+
+		gtl::parallel_flat_hash_map<int64_t,int> id_not_redirect_map;
+		gtl::parallel_flat_hash_map<int64_t,int> link_target_i;
+
+		//stages are checkpointed (see load_checkpoint): page gives name_id and id_not_redirect, targets gives
+		//id_not_redirect and link_target_i (so page, redirects and linktarget aren't needed), and links gives
+		//pagelinks_rows
+		string page_stamp = checkpoint_stamp({page}), targets_stamp = checkpoint_stamp({page, redirects, linktarget});
+		string links_stamp = checkpoint_stamp({pagelinks});
+
+		auto parse_page = [&]() {
+			bool loaded = load_checkpoint("page", page_stamp, [&](istream& in) {
+				gtl::vector<int64_t> ids;
+				gtl::vector<uint32_t> lens;
+				gtl::vector<char> chars;
+				read_vec(in, id_not_redirect);
+				read_vec(in, ids);
+				read_vec(in, lens);
+				read_vec(in, chars);
+
+				name_id.reserve(ids.size());
+				size_t off=0;
+				for (size_t i=0; i<ids.size(); off+=lens[i++])
+					name_id.emplace(string(chars.data()+off, lens[i]), ids[i]);
+			});
+
+			if (loaded) return;
+
+			int64_t cur_id=0;
+			bool in_ns=false;
+
+			parse(page, "page", [&](Value& v, int rec_i) {
+				if (rec_i==3 && in_ns) {
+					if (!get<int64_t>(v)) id_not_redirect.push_back(cur_id);
+				} else if (rec_i==2 && in_ns) {
+					name_id.emplace(std::move(get<string>(v)), cur_id);
+				} else if (rec_i==1) {
+					in_ns=get<int64_t>(v)==wiki_ns;
+				} else if (rec_i==0) {
+					cur_id = get<int64_t>(v);
+				}
+			});
+
+			progress("done with pages\n");
+			progress(name_id.size(), " total, ", id_not_redirect.size(), " are not redirects\n");
+			sort(id_not_redirect.begin(), id_not_redirect.end());
+
+			save_checkpoint("page", page_stamp, [&](ostream& out) {
+				gtl::vector<int64_t> ids;
+				gtl::vector<uint32_t> lens;
+				gtl::vector<char> chars;
+				for (auto const& [name, id]: name_id) {
+					ids.push_back(id);
+					lens.push_back(name.size());
+					chars.insert(chars.end(), name.begin(), name.end());
 				}
+
+				write_vec(out, id_not_redirect);
+				write_vec(out, ids);
+				write_vec(out, lens);
+				write_vec(out, chars);
+			});
+		};
+
+		auto build_id_map = [&]() {
+			id_not_redirect_map.reserve(id_not_redirect.size());
+			for (int i=0; i<id_not_redirect.size(); i++)
+				id_not_redirect_map.emplace(id_not_redirect[i], i);
+		};
+
+		//(id, title) for rows in wiki_ns
+		auto parse_titles = [](string const& path, string const& name, gtl::vector<pair<int64_t,string>>& rows) {
+			return [&path, &name, &rows]() {
+				int64_t cur_id=0;
+				bool in_ns=false;
+
+				parse(path, name, [&](Value& v, int rec_i) {
+					if (rec_i==0) cur_id=get<int64_t>(v);
+					else if (rec_i==1) in_ns=get<int64_t>(v)==wiki_ns;
+					else if (rec_i==2 && in_ns) rows.emplace_back(cur_id, std::move(get<string>(v)));
+				});
+
+				progress("done with ", name, ", ", rows.size(), " rows\n");
+			};
+		};
+
+		Tasks resolve;
+		resolve.run([&]() {
+			bool loaded = load_checkpoint("targets", targets_stamp, [&](istream& in) {
+				gtl::vector<int64_t> targets;
+				gtl::vector<int> idx;
+				read_vec(in, id_not_redirect);
+				read_vec(in, targets);
+				read_vec(in, idx);
+
+				link_target_i.reserve(targets.size());
+				for (size_t i=0; i<targets.size(); i++) link_target_i.emplace(targets[i], idx[i]);
+			});
+
+			if (loaded) {
+				build_id_map();
+				return;
 			}
 
-			return -1;
-		}
-		
-		gtl::parallel_flat_hash_map<int, gtl::vector<array<int,2>>> visited;
-		gtl::vector<int> a,b;
-		gtl::parallel_flat_hash_set<int> visited_2;
-		gtl::vector<int> sources;
-
-		auto add_source = [&]() -> bool {
-			int source = uniform_int_distribution<>(0,d.n-1)(rng);
-			int source_i=sources.size();
-			sources.push_back(source);
-
-			a={source};
-			visited_2={source};
-			visited[source].push_back(array<int,2>{source_i,0});
-
-			int l1=1;
-			for (; visited_2.size()<1e3 && a.size(); l1++) {
-				for (int x: a) {
-					int v = d.goto_adj(x, false);
-					while (v--) {
-						int y = d.read();
-						if (!visited_2.contains(y)) {
-							b.push_back(y);
-							visited_2.insert(y);
-							visited[y].push_back(array<int,2>{source_i,l1});
-
-							if (l1>=lb) {
-								cout<<l1<<"\n"<<d.to_id(source)<<"\n";
-								cout<<d.to_id(y)<<"\n";
-								return true;
+			{
+				string redirects_name="redirects", linktarget_name="link targets";
+				Tasks parse_tasks;
+				parse_tasks.run(parse_page);
+				parse_tasks.run(parse_titles(redirects, redirects_name, redirect_rows));
+				parse_tasks.run(parse_titles(linktarget, linktarget_name, linktarget_rows));
+				parse_tasks.join();
+			}
+
+			progress("id for Freguesia is ", name_id["Freguesia"], "\n");
+
+			gtl::parallel_flat_hash_map<int64_t, gtl::vector<int64_t>> redirect_from;
+			for (auto& [from, title]: redirect_rows) {
+				auto it = name_id.find(title);
+				if (it!=name_id.end()) redirect_from[it->second].push_back(from);
+			}
+
+			redirect_rows={};
+
+			progress("DFSing redirects...\n");
+			gtl::parallel_flat_hash_map<int64_t, int64_t> id_to;
+			vector<int64_t> stack;
+			for (int64_t id: id_not_redirect) {
+				stack.push_back(id);
+				id_to[id]=id;
+				while (stack.size()) {
+					auto it = redirect_from.find(stack.back());
+					stack.pop_back();
+
+					if (it!=redirect_from.end()) {
+						for (int64_t y: it->second) {
+							auto to = id_to.find(y);
+							if (to==id_to.end()) {
+								id_to[y]=id;
+								stack.push_back(y);
 							}
 						}
 					}
 				}
+			}
+
+			redirect_from={};
 
-				a.swap(b);
-				b.clear();
+			progress("handling link targets\n");
+			build_id_map();
+
+			progress("index of freguesia is ", id_not_redirect_map[name_id["Freguesia"]], "\n");
+
+			//lookups only, so the rows can be resolved in parallel
+			gtl::vector<int> target_i(linktarget_rows.size(), -1);
+			parallel_for(linktarget_rows.size(), [&](size_t l, size_t r) {
+				for (size_t i=l; i<r; i++) {
+					auto it = name_id.find(linktarget_rows[i].second);
+					if (it==name_id.end()) continue;
+					auto it2 = id_to.find(it->second);
+					if (it2==id_to.end()) continue;
+					target_i[i] = id_not_redirect_map.find(it2->second)->second;
+				}
+			});
+
+			link_target_i.reserve(linktarget_rows.size());
+			for (size_t i=0; i<linktarget_rows.size(); i++)
+				if (target_i[i]!=-1) link_target_i.emplace(linktarget_rows[i].first, target_i[i]);
+
+			progress("resolved link targets\n");
+			progress(link_target_i.size(), " targets\n");
+
+			linktarget_rows={};
+			name_id={};
+
+			save_checkpoint("targets", targets_stamp, [&](ostream& out) {
+				gtl::vector<int64_t> targets;
+				gtl::vector<int> idx;
+				for (auto [t, i]: link_target_i) targets.push_back(t), idx.push_back(i);
+
+				write_vec(out, id_not_redirect);
+				write_vec(out, targets);
+				write_vec(out, idx);
+			});
+		});
+
+		if (!load_checkpoint("links", links_stamp, [&](istream& in) {read_vec(in, pagelinks_rows);})) {
+			int64_t cur_id=0;
+			bool in_ns=false;
+
+			parse(pagelinks, "page links", [&](Value& v, int rec_i) {
+				if (rec_i==0) cur_id=get<int64_t>(v);
+				else if (rec_i==1) in_ns=get<int64_t>(v)==wiki_ns;
+				else if (rec_i==2 && in_ns) pagelinks_rows.push_back({cur_id, get<int64_t>(v)});
+			});
+
+			progress("done with page links, ", pagelinks_rows.size(), " rows\n");
+			save_checkpoint("links", links_stamp, [&](ostream& out) {write_vec(out, pagelinks_rows);});
+		}
+
+		resolve.join();
+
+		cout<<"computing adj lists\n";
+		gtl::vector<array<int,2>> edges(pagelinks_rows.size());
+		parallel_for(pagelinks_rows.size(), [&](size_t l, size_t r) {
+			for (size_t i=l; i<r; i++) {
+				edges[i]={-1,-1};
+				auto from = id_not_redirect_map.find(pagelinks_rows[i][0]);
+				if (from==id_not_redirect_map.end()) continue;
+				auto to = link_target_i.find(pagelinks_rows[i][1]);
+				if (to==link_target_i.end()) continue;
+				edges[i]={from->second, to->second};
 			}
+		});
 
-			return false;
-		};
+		pagelinks_rows={};
 
-		gtl::vector<int> bad;
-		auto add_target = [&]() -> bool {
-			int n_bad;
-			bad.assign(sources.size(), 0);
-
-			int target = uniform_int_distribution<>(0,d.n-1)(rng);
-			if (visited.contains(target)) return false;
-
-			a={target};
-
-			n_bad=0;
-			visited_2.clear();
-			visited_2.insert(target);
-
-			for (int l=1; n_bad<sources.size() && a.size(); l++) {
-				for (int x: a) {
-					int v = d.goto_adj(x, true);
-					while (v--) {
-						int y = d.read();
-						auto it = visited.find(y);
-						if (it!=visited.end()) {
-							for (auto [source_i, l1]: it->second) {
-								if (bad[source_i]) continue;
-								if (l+l1<lb) {
-									bad[source_i]=1; n_bad++;
-								} else {
-									cout<<l+l1<<"\n"<<d.to_id(sources[source_i])<<"\n"<<d.to_id(target)<<"\n";
-									return true;
-								}
-							}
-						}
-						
-						if (!visited_2.contains(y)) {
-							b.push_back(y);
-							visited_2.insert(y);
+		int n=id_not_redirect.size();
+		Csr adj = build_csr(n, edges, false), rev_adj = build_csr(n, edges, true);
+		edges={};
+
+		//offsets for both halves are ints in data.bin
+		int total = adj.to.size();
+		if (size_t(total)+rev_adj.to.size()>numeric_limits<int>::max()) throw runtime_error("too many links");
+
+		ofstream data(temp_path("./data.bin"), ios::binary);
+
+		int n_conv=convert(n);
+		data.write(reinterpret_cast<char*>(&n_conv), sizeof(int));
+
+		cout<<"writing ids\n";
+		write_big(data, id_not_redirect);
+
+		cout<<"writing adj list indices\n";
+		write_big(data, adj.end);
+		write_big(data, rev_adj.end, total);
+
+		cout<<"total at "<<total+rev_adj.to.size()<<"\n";
+		cout<<"writing adj lists\n";
+		write_big(data, adj.to);
+		write_big(data, rev_adj.to);
+
+		cout<<"computing pagerank\n";
+		write_big(data, rank_bits(pagerank(adj, rev_adj)));
+		data.close();
+
+		cout<<"checksumming\n";
+		append_checksum(temp_path("./data.bin"));
+		replace_file("./data.bin");
+
+		cout<<"exiting...\n";
+	} else if (action=="rank") {
+		//(re)computes the ranks of an existing data.bin
+		Csr adj, rev_adj;
+		size_t off4;
+		{
+			Data d;
+			if (d.n==0) return 0;
+			adj=d.read_csr(false);
+			rev_adj=d.read_csr(true);
+			off4=d.off4;
+		}
+
+		//older extracts didn't sort the lists
+		parallel_for(rev_adj.end.size(), [&](size_t l, size_t r) {
+			for (size_t i=l; i<r; i++)
+				sort(rev_adj.to.begin()+(i==0 ? 0 : rev_adj.end[i-1]), rev_adj.to.begin()+rev_adj.end[i]);
+		});
+
+		auto rank = pagerank(adj, rev_adj);
+
+		//the graph part is copied, ranks and checksum after it
+		filesystem::copy_file("./data.bin", temp_path("./data.bin"), filesystem::copy_options::overwrite_existing);
+		filesystem::resize_file(temp_path("./data.bin"), off4);
+		{
+			ofstream data(temp_path("./data.bin"), ios::binary | ios::app);
+			write_big(data, rank_bits(rank));
+		}
+
+		append_checksum(temp_path("./data.bin"));
+		replace_file("./data.bin");
+	} else if (action=="analyze") {
+		//writes data.idx from bfs to and from n_landmark random pages
+		int n_landmark=64;
+		ss>>n_landmark;
+		if (n_landmark<1 || n_landmark>255) throw runtime_error("landmarks must be in [1,255]");
+
+		Csr adj, rev_adj;
+		size_t data_size;
+		uint32_t data_checksum;
+		{
+			Data d;
+			if (d.n==0) return 0;
+			//data.idx records which data.bin it's for by its checksum
+			if (!d.checksum) throw runtime_error("data.bin has no checksum, run rank to add one");
+			data_size=d.size, data_checksum=*d.checksum;
+			adj=d.read_csr(false);
+			rev_adj=d.read_csr(true);
+		}
+
+		int n=adj.end.size();
+		gtl::vector<int> landmarks;
+		gtl::flat_hash_set<int> chosen;
+		while (landmarks.size()<min(n_landmark, n)) {
+			int x = uniform_int_distribution<>(0,n-1)(rng);
+			if (chosen.insert(x).second) landmarks.push_back(x);
+		}
+
+		gtl::vector<Profile> fwd(n), bwd(n);
+		array<int64_t,hist_len> hist {};
+
+		//a round is a bfs per thread into its own dist, then the counts are added up split by page
+		int n_thread = max(1u, thread::hardware_concurrency());
+		for (bool rev: {false, true}) {
+			auto& prof = rev ? bwd : fwd;
+			auto& g = rev ? adj : rev_adj;
+
+			for (size_t round=0; round<landmarks.size(); round+=n_thread) {
+				int n_round = min<size_t>(n_thread, landmarks.size()-round);
+				gtl::vector<gtl::vector<uint8_t>> dist(n_round, gtl::vector<uint8_t>(n));
+
+				parallel_for(n_round, [&](size_t l, size_t r) {
+					gtl::vector<int> q;
+					for (size_t t=l; t<r; t++) bfs_dist(g, landmarks[round+t], dist[t], q);
+				});
+
+				mutex hist_m;
+				parallel_for(n, [&](size_t l, size_t r) {
+					array<int64_t,hist_len> local {};
+					for (size_t i=l; i<r; i++) {
+						for (auto const& dt: dist) {
+							uint8_t x=dt[i];
+							local[x]++;
+							if (x==255) continue;
+
+							prof[i].ecc = max(prof[i].ecc, x);
+							for (int h=0; h<=min<int>(x, profile_h); h++) prof[i].far[h]++;
 						}
 					}
 
-					if (n_bad>=sources.size()) break;
-				}
+					//distances from the landmarks, one direction is enough
+					if (rev) {
+						lock_guard lock(hist_m);
+						for (int x=0; x<hist_len; x++) hist[x]+=local[x];
+					}
+				});
 
-				a.swap(b);
-				b.clear();
+				progress(rev ? "backward" : "forward", " bfs ", round+n_round, "/", landmarks.size(), "\n");
 			}
-		
-			return false;
-		};
+		}
 
-		for (int i=0; i<100; i++) {
-			if (add_source() || add_target() || add_target()) return 0;
+		int64_t pairs=0;
+		for (int x=0; x<hist_len; x++) pairs+=hist[x];
+		for (int x=0; x<hist_len; x++) {
+			if (hist[x]) cout<<(x==255 ? "unreachable" : to_string(x))<<": "<<100.0*hist[x]/pairs<<"%\n";
 		}
 
-		return -1;
+		string path = index_path("./data.bin");
+		{
+			ofstream index(temp_path(path), ios::binary);
+			index.write(index_magic.data(), index_magic.size());
+			write_big(index, gtl::vector<int>{n, profile_h, int(landmarks.size())});
+			write_big(index, gtl::vector<int64_t>{int64_t(data_size)});
+			write_big(index, gtl::vector<uint32_t>{data_checksum});
+			write_big(index, gtl::vector<int64_t>(hist.begin(), hist.end()));
+			index.write(reinterpret_cast<char*>(fwd.data()), sizeof(Profile)*n);
+			index.write(reinterpret_cast<char*>(bwd.data()), sizeof(Profile)*n);
+		}
+
+		replace_file(path);
+	} else if (action=="verify") {
+		Data d;
+		if (!d.checksum) throw runtime_error("data.bin has no checksum, run rank to add one");
+		if (!d.verify()) throw runtime_error("data.bin doesn't match its checksum");
+		cout<<"ok\n";
+	} else if (action=="paths") {
+		//paths p1 p2 [k [banned]]
+		int64_t p1, p2; ss>>p1>>p2;
+		int k=1; ss>>k;
+		string banned_path; ss>>banned_path;
+
+		Data d;
+		int p1_i = d.from_id(p1), p2_i = d.from_id(p2);
+		if (p1_i==-1 || p2_i==-1) throw runtime_error("page not found");
+
+		optional<gtl::bit_vector> banned;
+		if (banned_path.size()) banned=read_banned(d, banned_path);
+
+		auto dag = path_dag(d, p1_i, p2_i, k, rng, banned ? &*banned : nullptr);
+		if (!dag) {
+			cout<<"-1\n";
+			return 0;
+		}
+
+		//distance, # of paths, widths, then each sampled path's ids and choices
+		cout<<dag->distance<<"\n"<<dag->n_paths<<"\n";
+		for (int w: dag->width) cout<<w<<" ";
+		cout<<"\n";
+
+		for (int i=0; i<k; i++) {
+			for (int x: dag->paths[i]) cout<<d.to_id(x)<<" ";
+			cout<<"\n";
+			for (int c: dag->choices[i]) cout<<c<<" ";
+			cout<<"\n";
+		}
+	} else if (action=="build-store") {
+		//pages.bin from an enterprise html dump (ndjson, can be gzip/zstd)
+		string dump; ss>>dump;
+
+		Data d;
+		gtl::vector<int64_t> ids(d.n);
+		d.seek(d.off1);
+		d.read_all(ids);
+
+		build_store(dump, ids, temp_path("./pages.bin"));
+		replace_file("./pages.bin");
+	} else if (action=="page") {
+		//by id, or by title if that isn't an id in the store
+		string key;
+		getline(ss>>ws, key);
+
+		PageStore store("./pages.bin");
+		int i=-1;
+		int64_t id;
+		auto res = from_chars(key.data(), key.data()+key.size(), id);
+		if (res.ec==errc() && res.ptr==key.data()+key.size()) i=store.find_id(id);
+		if (i==-1) i=store.find_title(key);
+
+		auto page = store.get(i);
+		if (!page) throw runtime_error("page not found");
+
+		print_page_json(cout, store.id(i), *page);
+		cout<<"\n";
+	} else if (action=="select") {
+		//select lb [banned]
+		Data d;
+		int lb; ss>>lb;
+		string banned_path; ss>>banned_path;
+
+		optional<gtl::bit_vector> banned;
+		if (banned_path.size()) banned=read_banned(d, banned_path);
+
+		auto res = select(d, lb, rng, banned ? &*banned : nullptr);
+		if (!res) return -1;
+
+		auto [dist, source, target] = *res;
+		cout<<dist<<"\n"<<d.to_id(source)<<"\n"<<d.to_id(target)<<"\n";
 	} else if (action=="distance") {
+		//distance p1 p2 [banned], banned being a file of page ids to avoid
 		int64_t p1, p2; ss>>p1>>p2;
+		string banned_path; ss>>banned_path;
 
 		Data d;
 		int p1_i = d.from_id(p1), p2_i = d.from_id(p2);
 
+		optional<gtl::bit_vector> banned;
+		if (banned_path.size()) banned=read_banned(d, banned_path);
+
 		if (p1_i==-1 || p2_i==-1) {
 			throw runtime_error("page not found");
 		} else if (p1_i==p2_i) {
@@ -577,7 +2446,7 @@ int main(int argc, char** argv) {
 			return 0;
 		}
 
-		auto path = path_between(d, p1_i, p2_i);
+		auto path = path_between(d, p1_i, p2_i, nullptr, banned ? &*banned : nullptr);
 		if (path.empty()) {
 			cout<<"-1\n";
 		} else {
@@ -587,4 +2456,5 @@ int main(int argc, char** argv) {
 	} else {
 		throw runtime_error("oh fuck");
 	}
-}
\ No newline at end of file
+}
+#endif
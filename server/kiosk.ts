@@ -0,0 +1,377 @@
+import { MineDifficulty, MineHint } from "../src/server.d.ts";
+
+// the engines loaded in-process through libkiosk's C ABI (cpp/kiosk.h) instead of spawning build/main and build/wiki
+const libName = Deno.build.os=="darwin" ? "libkiosk.dylib" : Deno.build.os=="windows" ? "kiosk.dll" : "libkiosk.so";
+
+const lib = Deno.dlopen(`cpp/build/${libName}`, {
+	kiosk_last_error: { parameters: [], result: "pointer" },
+	kiosk_stats: { parameters: ["buffer", "i32"], result: "i32" },
+	kiosk_generate: {
+		parameters: ["i32", "i32", "i32", "i32", "i32", "buffer", "u64", "i32", "buffer", "buffer"],
+		result: "i32", nonblocking: true
+	},
+	kiosk_solver_new: { parameters: ["i32", "i32", "i32"], result: "pointer" },
+	kiosk_solver_free: { parameters: ["pointer"], result: "void" },
+	kiosk_solver_hint: { parameters: ["pointer", "buffer", "buffer", "buffer"], result: "i32", nonblocking: true },
+	kiosk_graph_open: { parameters: ["buffer"], result: "pointer" },
+	kiosk_graph_free: { parameters: ["pointer"], result: "void" },
+	kiosk_graph_reload: { parameters: ["pointer", "buffer"], result: "i32", nonblocking: true },
+	kiosk_graph_paths: {
+		parameters: ["pointer", "i64", "i64", "pointer", "i32", "u64", "i32", "buffer", "buffer", "buffer", "buffer"],
+		result: "i32", nonblocking: true
+	},
+	kiosk_graph_distances: {
+		parameters: ["pointer", "buffer", "i32", "i64", "pointer", "buffer", "pointer"],
+		result: "i32", nonblocking: true
+	},
+	kiosk_graph_select: { parameters: ["pointer", "i32", "pointer", "u64", "buffer"], result: "i32", nonblocking: true },
+	kiosk_banned_new: { parameters: ["buffer", "i32"], result: "pointer" },
+	kiosk_banned_free: { parameters: ["pointer"], result: "void" },
+	kiosk_store_open: { parameters: ["buffer"], result: "pointer" },
+	kiosk_store_free: { parameters: ["pointer"], result: "void" },
+	kiosk_store_page: { parameters: ["pointer", "i64", "buffer", "buffer", "i32"], result: "i32", nonblocking: true },
+	kiosk_cancel_new: { parameters: [], result: "pointer" },
+	kiosk_cancel_set: { parameters: ["pointer"], result: "void" },
+	kiosk_cancel_free: { parameters: ["pointer"], result: "void" }
+} as const);
+
+const encoder = new TextEncoder();
+const cString = (x: string) => encoder.encode(x+"\0");
+
+// only meaningful after a blocking call, nonblocking ones run on another thread
+function lastError() {
+	const ptr = lib.symbols.kiosk_last_error();
+	return ptr==null ? "" : Deno.UnsafePointerView.getCString(ptr);
+}
+
+const intMax = 2**31-1;
+
+// board as a row-major bitset (least significant bit first), or null if generation failed/parameters are invalid
+export async function generateBoard(size: readonly [number, number], nMine: number, start: readonly [number, number],
+	difficulty?: MineDifficulty, seed?: number, cachePath?: string): Promise<boolean[][]|null> {
+	const [h,w] = size;
+	const diff = difficulty==undefined ? null : new Int32Array([
+		difficulty.deductions?.[0] ?? 0, difficulty.deductions?.[1] ?? intMax,
+		difficulty.depth ?? intMax,
+		difficulty.bbbv?.[0] ?? 0, difficulty.bbbv?.[1] ?? intMax
+	]);
+
+	const bits = new Uint8Array(Math.ceil(h*w/8));
+	const res = await lib.symbols.kiosk_generate(h, w, nMine, start[0], start[1], diff,
+		BigInt(seed ?? 0), seed==undefined ? 0 : 1, cachePath==undefined ? null : cString(cachePath), bits);
+
+	if (res!=1) return null;
+	return [...Array(h)].map((_,i)=>[...Array(w)].map((_,j)=>{
+		const x = i*w+j;
+		return (bits[x>>3]>>(x&7)&1)==1;
+	}));
+}
+
+// solver for one player's board, so its cache stays warm between hints.
+// queries run one at a time in order, since they share flags and prob, and close frees the solver only once
+// the last of them is done (a nonblocking call can still be using it)
+export class HintSolver {
+	private ptr: Deno.PointerValue;
+	private flags: Uint8Array;
+	private prob: Float64Array;
+	private last: Promise<unknown> = Promise.resolve();
+
+	constructor(private size: readonly [number, number], nMine: number) {
+		this.ptr = lib.symbols.kiosk_solver_new(size[0], size[1], nMine);
+		if (this.ptr==null) throw new Error(`couldn't create solver: ${lastError()}`);
+
+		this.flags = new Uint8Array(size[0]*size[1]);
+		this.prob = new Float64Array(size[0]*size[1]);
+	}
+
+	query(known: number[][]): Promise<MineHint|null> {
+		const out = this.last.then(()=>this.solve(known));
+		this.last = out.catch(()=>{});
+		return out;
+	}
+
+	private async solve(known: number[][]): Promise<MineHint|null> {
+		if (this.ptr==null) throw new Error("solver closed");
+
+		const [h,w] = this.size;
+		const res = await lib.symbols.kiosk_solver_hint(this.ptr, new Int8Array(known.flat()), this.flags, this.prob);
+		if (res==-1) throw new Error("invalid board");
+		if (res==0) return null;
+
+		const hint: MineHint = {safe: [], mine: [], prob: []};
+		for (let i=0; i<h; i++) {
+			hint.prob.push([]);
+			for (let j=0; j<w; j++) {
+				const x = i*w+j;
+				if (this.flags[x]==1) hint.safe.push([i,j]);
+				else if (this.flags[x]==2) hint.mine.push([i,j]);
+				hint.prob[i].push(Math.round(this.prob[x]*1000)/1000);
+			}
+		}
+
+		return hint;
+	}
+
+	close() {
+		const ptr = this.ptr;
+		this.ptr=null;
+		if (ptr!=null) this.last.then(()=>lib.symbols.kiosk_solver_free(ptr));
+	}
+}
+
+// data.bin opened once for every distance/select query
+let graph: Deno.PointerValue = null;
+function getGraph() {
+	if (graph==null) {
+		graph = lib.symbols.kiosk_graph_open(cString("cpp/data.bin"));
+		if (graph==null) throw new Error(`couldn't open graph: ${lastError()}`);
+	}
+
+	return graph;
+}
+
+// loads data.bin again (after extract or rank replaced it) and swaps it in once it checks out.
+// queries keep going on the old graph meanwhile
+export async function reloadGraph() {
+	if (graph==null) return getGraph();
+	if (await lib.symbols.kiosk_graph_reload(graph, null)!=1)
+		throw new Error("couldn't reload graph, see `wiki verify`");
+}
+
+// pages a game variant doesn't allow, which paths avoid and select won't pick. made once per game,
+// and not closed while queries using it might still run
+export class BannedPages {
+	ptr: Deno.PointerValue;
+
+	constructor(ids: number[]) {
+		this.ptr = lib.symbols.kiosk_banned_new(new BigInt64Array(ids.map(x=>BigInt(x))), ids.length);
+		if (this.ptr==null) throw new Error(`couldn't create banned pages: ${lastError()}`);
+	}
+
+	close() {
+		if (this.ptr!=null) lib.symbols.kiosk_banned_free(this.ptr);
+		this.ptr=null;
+	}
+}
+
+export type GraphPaths = {
+	distance: number,
+	// # of shortest paths, saturating at 2^64-1 (and only approximate past 2^53)
+	count: number,
+	// # of pages which can be at each position on a shortest path
+	width: number[],
+	// uniformly sampled shortest paths as page ids including both ends, with the # of links at each page
+	// that stay on a shortest path
+	paths: {pages: number[], choices: number[]}[]
+};
+
+// (longer paths than this don't happen on wikipedia)
+const maxPath = 256;
+// null if either page isn't in the graph or there's no path
+export async function graphPaths(from: number, to: number, k: number, banned?: BannedPages): Promise<GraphPaths|null> {
+	const count = new BigUint64Array(1), width = new Int32Array(maxPath);
+	const pages = new BigInt64Array(k*maxPath), choices = new Int32Array(k*maxPath);
+	const seed = BigInt(Math.floor(Math.random()*2**32));
+
+	const len = await lib.symbols.kiosk_graph_paths(getGraph(), BigInt(from), BigInt(to), banned?.ptr ?? null,
+		k, seed, maxPath, count, width, pages, choices);
+	if (len<=0) return null;
+
+	return {
+		distance: len-1,
+		count: Number(count[0]),
+		width: [...width.slice(0, len)],
+		paths: [...Array(k)].map((_,i)=>({
+			pages: [...pages.slice(i*maxPath, i*maxPath+len)].map(x=>Number(x)),
+			choices: [...choices.slice(i*maxPath, i*maxPath+len)]
+		}))
+	};
+}
+
+// distance queries are queued: identical (from, to, banned) queries share a job, pending jobs with the same
+// target and banned pages are answered together by one backward search, and up to maxRunningDistances searches
+// run at once (each reads the graph on its own). a job nobody is waiting on anymore is dropped, or its search is
+// cancelled between levels if it's already running and nobody is waiting on the rest of its batch either
+type DistanceJob = {
+	key: string, from: number, to: number, banned: BannedPages|null,
+	waiting: number,
+	resolve: (x: number|null)=>void,
+	promise: Promise<number|null>
+};
+
+type DistanceBatch = {jobs: DistanceJob[], cancel: Deno.PointerValue};
+
+const maxRunningDistances = Math.max(1, navigator.hardwareConcurrency);
+const distanceJobs = new Map<string, DistanceJob>();
+let pendingDistances: DistanceJob[] = [];
+const runningDistances = new Set<DistanceBatch>();
+
+function runDistances() {
+	while (pendingDistances.length>0 && runningDistances.size<maxRunningDistances) {
+		const {to, banned} = pendingDistances[0];
+		const same = (x: DistanceJob)=>x.to==to && x.banned==banned;
+		const jobs = pendingDistances.filter(same);
+		pendingDistances = pendingDistances.filter(x=>!same(x));
+
+		const batch = {jobs, cancel: lib.symbols.kiosk_cancel_new()};
+		runningDistances.add(batch);
+		runDistanceBatch(batch, to, banned);
+	}
+}
+
+async function runDistanceBatch(batch: DistanceBatch, to: number, banned: BannedPages|null) {
+	const {jobs, cancel} = batch;
+	const out = new Int32Array(jobs.length);
+	const res = await lib.symbols.kiosk_graph_distances(getGraph(),
+		new BigInt64Array(jobs.map(x=>BigInt(x.from))), jobs.length, BigInt(to), banned?.ptr ?? null, out, cancel);
+
+	runningDistances.delete(batch);
+	lib.symbols.kiosk_cancel_free(cancel);
+
+	jobs.forEach((x,i)=>{
+		if (distanceJobs.get(x.key)==x) distanceJobs.delete(x.key);
+		x.resolve(res==1 && out[i]!=-2 ? out[i] : null);
+	});
+
+	runDistances();
+}
+
+// to tell banned sets apart in job keys
+let nextBannedKey = 0;
+const bannedKeys = new WeakMap<BannedPages, number>();
+
+// # of links from one page to another avoiding banned pages, -1 if there's no path.
+// null if either page isn't in the graph, or if signal was aborted first
+export function graphDistance(from: number, to: number, signal?: AbortSignal, banned?: BannedPages): Promise<number|null> {
+	getGraph();
+	if (signal?.aborted) return Promise.resolve(null);
+
+	let bannedKey = "";
+	if (banned!=undefined) {
+		if (!bannedKeys.has(banned)) bannedKeys.set(banned, nextBannedKey++);
+		bannedKey = `-${bannedKeys.get(banned)}`;
+	}
+
+	const key = `${from}-${to}${bannedKey}`;
+	let job = distanceJobs.get(key);
+	if (job==undefined) {
+		let resolve: DistanceJob["resolve"] = ()=>{};
+		const promise = new Promise<number|null>(res=>{resolve=res;});
+		job = {key, from, to, banned: banned ?? null, waiting: 0, resolve, promise};
+
+		distanceJobs.set(key, job);
+		pendingDistances.push(job);
+		// started on the next microtask so queries made together land in the same batch
+		if (runningDistances.size<maxRunningDistances && pendingDistances.length==1) queueMicrotask(runDistances);
+	}
+
+	const j = job;
+	j.waiting++;
+
+	return new Promise(resolve=>{
+		j.promise.then(resolve);
+
+		signal?.addEventListener("abort", ()=>{
+			resolve(null);
+			if (--j.waiting>0) return;
+
+			if (pendingDistances.includes(j)) {
+				pendingDistances = pendingDistances.filter(x=>x!=j);
+				distanceJobs.delete(key);
+				j.resolve(null);
+			} else {
+				const batch = [...runningDistances].find(b=>b.jobs.includes(j));
+				if (batch!=undefined && batch.jobs.every(x=>x.waiting==0)) {
+					// new queries for these shouldn't join a search that's stopping
+					for (const x of batch.jobs) distanceJobs.delete(x.key);
+					lib.symbols.kiosk_cancel_set(batch.cancel);
+				}
+			}
+		}, {once: true});
+	});
+}
+
+export async function graphSelect(minDistance: number, banned?: BannedPages):
+	Promise<{start: number, end: number, distance: number}|null> {
+	const out = new BigInt64Array(3);
+	const seed = BigInt(Math.floor(Math.random()*2**32));
+	if (await lib.symbols.kiosk_graph_select(getGraph(), minDistance, banned?.ptr ?? null, seed, out)!=1) return null;
+	return {start: Number(out[0]), end: Number(out[1]), distance: Number(out[2])};
+}
+
+export type StoredPage = {
+	title: string, pageid: number, text: string,
+	sections: {toclevel: number, anchor: string, line: string}[]
+};
+
+// a pages.bin from `wiki build-store`, mapped while open
+export class PageStore {
+	private ptr: Deno.PointerValue;
+
+	constructor(path: string) {
+		this.ptr = lib.symbols.kiosk_store_open(cString(path));
+		if (this.ptr==null) throw new Error(`couldn't open page store: ${lastError()}`);
+	}
+
+	// like the parse api's parse object, null if the page isn't stored
+	async page(opt: {pageid: number}|{name: string}): Promise<StoredPage|null> {
+		if (this.ptr==null) throw new Error("page store closed");
+
+		const id = "pageid" in opt ? BigInt(opt.pageid) : 0n, title = "name" in opt ? cString(opt.name) : null;
+		let buf = new Uint8Array(1<<20);
+		let len = await lib.symbols.kiosk_store_page(this.ptr, id, title, buf, buf.length);
+		if (len>buf.length) {
+			buf = new Uint8Array(len);
+			len = await lib.symbols.kiosk_store_page(this.ptr, id, title, buf, buf.length);
+		}
+
+		if (len==-1) throw new Error("couldn't read page store");
+		if (len==0) return null;
+		return JSON.parse(new TextDecoder().decode(buf.subarray(0, len))) as StoredPage;
+	}
+
+	close() {
+		if (this.ptr!=null) lib.symbols.kiosk_store_free(this.ptr);
+		this.ptr=null;
+	}
+}
+
+// cpp/pages.bin, null if there isn't one
+const storePath = "cpp/pages.bin";
+let store: PageStore|null|undefined = undefined;
+function getStore() {
+	if (store===undefined) {
+		try {
+			Deno.statSync(storePath);
+		} catch {
+			return store=null;
+		}
+
+		store = new PageStore(storePath);
+	}
+
+	return store;
+}
+
+// page from the local store. null if there's no store or the page isn't in it
+export async function storePage(opt: {pageid: number}|{name: string}): Promise<StoredPage|null> {
+	return await getStore()?.page(opt) ?? null;
+}
+
+export type EngineStats = {
+	counters: Record<string, number>,
+	timers: Record<string, {calls: number, sec: number}>
+};
+
+// null unless libkiosk was built with ENGINE_STATS
+export function engineStats(): EngineStats|null {
+	let buf = new Uint8Array(4096);
+	let len = lib.symbols.kiosk_stats(buf, buf.length);
+	if (len>buf.length) {
+		buf = new Uint8Array(len);
+		len = lib.symbols.kiosk_stats(buf, buf.length);
+	}
+
+	if (len==0) return null;
+	return (JSON.parse(new TextDecoder().decode(buf.subarray(0, len))) as {stats: EngineStats}).stats;
+}
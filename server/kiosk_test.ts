@@ -0,0 +1,138 @@
+import assert from "node:assert/strict";
+import { PageStore, StoredPage } from "./kiosk.ts";
+
+// needs cpp/build/libkiosk, run with `deno task test`
+
+const encoder = new TextEncoder();
+
+// fnv-1a like wiki.cpp's title_hash, for titles that are already normalized
+function titleHash(title: string) {
+	let out = 0xcbf29ce484222325n;
+	for (const c of encoder.encode(title)) out = BigInt.asUintN(64, (out^BigInt(c))*0x100000001b3n);
+	return out;
+}
+
+class BigEndian {
+	parts: Uint8Array[] = [];
+	size = 0;
+
+	bytes(x: Uint8Array) {this.parts.push(x); this.size+=x.length;}
+	private num(n: number, f: (v: DataView)=>void) {
+		const x = new Uint8Array(n);
+		f(new DataView(x.buffer));
+		this.bytes(x);
+	}
+
+	u32(x: number) {this.num(4, v=>v.setUint32(0, x));}
+	u64(x: bigint|number) {this.num(8, v=>v.setBigUint64(0, BigInt(x)));}
+	str(x: string) {const b = encoder.encode(x); this.u32(b.length); this.bytes(b);}
+
+	done() {
+		const out = new Uint8Array(this.size);
+		let off=0;
+		for (const x of this.parts) out.set(x, off), off+=x.length;
+		return out;
+	}
+}
+
+// a zstd frame of uncompressed blocks, so no compressor is needed
+function zstdRaw(x: Uint8Array) {
+	const out = new BigEndian();
+	// magic, then single segment with a 4 byte content size
+	out.bytes(new Uint8Array([0x28, 0xb5, 0x2f, 0xfd, 0xa0]));
+	out.bytes(new Uint8Array(new Uint32Array([x.length]).buffer));
+
+	const block = 1<<17;
+	for (let i=0; i==0 || i<x.length; i+=block) {
+		const len = Math.min(block, x.length-i), last = i+block>=x.length ? 1 : 0;
+		const hdr = len<<3 | last;
+		out.bytes(new Uint8Array([hdr&0xff, hdr>>8&0xff, hdr>>16&0xff]));
+		out.bytes(x.subarray(i, i+len));
+	}
+
+	return out.done();
+}
+
+// collisions are titles whose hash is written as another title's, to check lookups compare the title itself
+type FixturePage = StoredPage & {redirects: string[], collisions?: string[]};
+
+// pages.bin laid out like build_store writes it (see wiki.cpp), without a dictionary.
+// ids are data.bin's, pages the ones of them stored
+function writeStore(path: string, ids: number[], pages: FixturePage[]) {
+	const records = new BigEndian();
+	const offset = ids.map(()=>0), size = ids.map(()=>0);
+	const titles: [bigint, number, string][] = [];
+
+	for (const page of pages) {
+		const i = ids.indexOf(page.pageid);
+		const rec = new BigEndian();
+		rec.str(page.title);
+		rec.u32(page.sections.length);
+		for (const sec of page.sections) rec.u32(sec.toclevel), rec.str(sec.anchor), rec.str(sec.line);
+		rec.bytes(encoder.encode(page.text));
+
+		const frame = zstdRaw(rec.done());
+		offset[i]=records.size, size[i]=frame.length;
+		records.bytes(frame);
+
+		for (const t of [page.title, ...page.redirects]) titles.push([titleHash(t), i, t]);
+		for (const t of page.collisions ?? []) titles.push([titleHash(t), i, `${t} (collision)`]);
+	}
+
+	titles.sort((a,b)=>a[0]<b[0] ? -1 : a[0]>b[0] ? 1 : a[1]-b[1]);
+	const keys = titles.map(([,,t])=>encoder.encode(t));
+
+	const out = new BigEndian();
+	const header = 8+4+3*8;
+	out.bytes(encoder.encode("WIKISTO2"));
+	out.u32(ids.length);
+	out.u64(0), out.u64(titles.length), out.u64(header+records.size);
+
+	out.bytes(records.done());
+	for (const x of ids) out.u64(x);
+	for (const x of offset) out.u64(x);
+	for (const x of size) out.u32(x);
+	for (const [h] of titles) out.u64(h);
+	for (const [,i] of titles) out.u32(i);
+	let keyOffset=0;
+	out.u64(0);
+	for (const k of keys) out.u64(keyOffset+=k.length);
+	for (const k of keys) out.bytes(k);
+
+	Deno.writeFileSync(path, out.done());
+}
+
+Deno.test("page store", async ()=>{
+	const path = Deno.makeTempFileSync({suffix: ".bin"});
+	const pages: FixturePage[] = [
+		{
+			title: "Minesweeper", pageid: 12, redirects: ["Mine sweeper"], collisions: ["Tetris"],
+			text: "<div class=\"mw-parser-output\"><p>a \"game\"\n</p></div>",
+			sections: [{toclevel: 1, anchor: "History", line: "History"}, {toclevel: 2, anchor: "Windows", line: "Windows"}]
+		},
+		// bigger than storePage's first buffer
+		{title: "Long page", pageid: 40, redirects: [], text: "x".repeat((1<<20)+12345), sections: []}
+	];
+
+	writeStore(path, [3, 12, 25, 40], pages);
+	const store = new PageStore(path);
+
+	try {
+		const strip = ({redirects: _, collisions: __, ...x}: FixturePage): StoredPage => x;
+		assert.deepEqual(await store.page({pageid: 12}), strip(pages[0]));
+		assert.deepEqual(await store.page({name: "Minesweeper"}), strip(pages[0]));
+		assert.deepEqual(await store.page({name: "mine_sweeper"}), strip(pages[0]));
+		assert.deepEqual(await store.page({pageid: 40}), strip(pages[1]));
+
+		// in data.bin but not stored, and not in either
+		assert.equal(await store.page({pageid: 3}), null);
+		assert.equal(await store.page({pageid: 7}), null);
+		// only its hash is in the store
+		assert.equal(await store.page({name: "Tetris"}), null);
+	} finally {
+		store.close();
+		Deno.removeSync(path);
+	}
+
+	assert.throws(()=>new PageStore(path));
+});
@@ -3,8 +3,9 @@ import { Hono } from "hono";
 import { serveStatic, upgradeWebSocket } from "hono/deno";
 import { createMiddleware } from "hono/factory";
 import { z } from "zod";
-import {MessageToServer, MessageToClient, Player, MineMessageToServer, WikiMessageToServer, WikiPage, WikiGameType} from "../src/server.d.ts";
+import {MessageToServer, MessageToClient, Player, MineMessageToServer, WikiMessageToServer, WikiPage, WikiGameType, MineDifficulty} from "../src/server.d.ts";
 import { addTime, getTimeIdx, getTimes, setTimeName } from "./db.ts";
+import { EngineStats, HintSolver, engineStats, generateBoard, graphDistance, graphPaths, graphSelect, reloadGraph, storePage } from "./kiosk.ts";
 import { Buffer } from "node:buffer";
 import process from "node:process";
 
@@ -21,6 +22,12 @@ const MineMessageToServerZod = z.union([
     type: z.literal("startGame"),
     size: z.tuple([z.number(), z.number()]),
     nMine: z.number(),
+    difficulty: z.object({
+			deductions: z.tuple([z.number(), z.number()]).optional(),
+			depth: z.number().optional(),
+			bbbv: z.tuple([z.number(), z.number()]).optional()
+		}).optional(),
+		seed: z.number().int().min(0).optional()
   }),
 	z.object({
 		type: z.literal("getTimes"),
@@ -33,6 +40,10 @@ const MineMessageToServerZod = z.union([
 	}),
 	z.object({
 		type: z.literal("addTime")
+	}),
+	z.object({
+		type: z.literal("hint"),
+		known: z.array(z.array(z.number().int().min(-1).max(8)))
 	})
 ]) satisfies z.ZodType<MineMessageToServer>;
 
@@ -113,8 +124,11 @@ let gameState: {
 	startSquare: readonly [number, number]|null,
 	board: boolean[][]|null,
 	nMine: number,
+	difficulty?: MineDifficulty,
+	seed?: number,
 	start: number,
-	playerTimes: Map<Player, {sec: number, id: number}>
+	playerTimes: Map<Player, {sec: number, id: number}>,
+	hints: Map<Player, HintSolver>
 }|{
 	type: "wiki",
 	// startPage: WikiPage,
@@ -122,6 +136,8 @@ let gameState: {
 	start: number,
 	end: number,
 	playerWentTo: Map<Player,string>,
+	// aborted when the player goes somewhere else or stops loading, so stale distance queries don't use cpu
+	loading: Map<Player,AbortController>,
 	game: WikiGameType
 }|null = null;
 
@@ -144,13 +160,15 @@ function refreshGame() {
 function setGame(newGame: typeof gameState) {
 	if (gameState!=null) {
 		sockets.forEach(x=>x({type: "gameEnd"}));
+		if (gameState.type=="mine") gameState.hints.forEach(x=>x.close());
 	}
 
 	gameState=newGame;
 	if (newGame!=null) refreshGame();
 }
 
-const decoder = new TextDecoder();
+// seeded boards are stored in the generator's board cache, so e.g. a daily board is only generated once
+const boardCache = "cpp/boards.bin";
 
 async function handleMine(player: Player, msg: MineMessageToServer) {
 	if (msg.type=="startGame") {
@@ -161,7 +179,10 @@ async function handleMine(player: Player, msg: MineMessageToServer) {
 			type: "mine",
 			size: msg.size, startSquare: null,
 			board: null, nMine: msg.nMine,
+			difficulty: msg.difficulty,
+			seed: msg.seed,
 			playerTimes: new Map(),
+			hints: new Map(),
 			start: Date.now()
 		});
 
@@ -187,18 +208,12 @@ async function handleMine(player: Player, msg: MineMessageToServer) {
 		case "flag":
 		case "reveal": {
 			if (msg.type=="reveal" && state.startSquare==null && msg.start) {
-				const res = await new Deno.Command("cpp/build/main", {
-					args: [state.size[0], state.size[1], state.nMine, msg.square[0], msg.square[1]]
-						.map(x=>x.toString())
-				}).output();
-
-				if (!res.success) throw new AppError("invalid board parameters");
-
-				const mines = new Set(decoder.decode(res.stdout).trim().split("\n"));
+				const board = await generateBoard(state.size, state.nMine, msg.square, state.difficulty,
+					state.seed, state.seed==undefined ? undefined : boardCache);
+				if (board==null) throw new AppError("invalid board parameters");
 
 				state.startSquare=msg.square;
-				state.board=[...Array(state.size[0])]
-					.map((_,i)=>[...new Array(state.size[1])].map((_,j) => mines.has(`${i},${j}`)))
+				state.board=board;
 
 				const startTime = Date.now();
 				sockets.forEach(x=>x({type: "mine", msg: {type: "gameStart", game: {
@@ -222,6 +237,20 @@ async function handleMine(player: Player, msg: MineMessageToServer) {
 
 			break;
 		}
+		case "hint": {
+			if (state.board==null) throw new AppError("game hasn't started");
+			if (msg.known.length!=state.size[0] || msg.known.some(row=>row.length!=state.size[1]))
+				throw new AppError("invalid board");
+
+			let solver = state.hints.get(player);
+			if (!solver) state.hints.set(player, solver=new HintSolver(state.size, state.nMine));
+
+			const hint = await solver.query(msg.known);
+			if (gameState!=state) return;
+
+			sockets.get(player)?.({type: "mine", msg: {type: "hint", hint}});
+			break;
+		}
 		case "addTime": {
 			if (state.playerTimes.has(player))
 				throw new AppError("invalid state");
@@ -272,23 +301,20 @@ const WikiParseResponse = z.object({
 	})
 }));
 
-async function getDistance(from: number, to: number): Promise<number[]|null> {
-	const res = await new Deno.Command("build/wiki", {
-		args: ["distance", from, to]
-			.map(x=>x.toString()),
-		cwd: "cpp"
-	}).output();
-
-	if (!res.success) return null;
-
-	return decoder.decode(res.stdout).trim().split("\n").slice(1).map(x=>Number.parseInt(x));
-}
-
 const toWikiPage = (x: Extract<z.infer<typeof WikiParseResponse>,{parse: object}>, d: number): WikiPage => ({
 	name: x.parse.title, distance: d, content: x.parse.text, sections: x.parse.sections
 });
 
+const darkMode = /@media\s*\(prefers-color-scheme:\s*dark\)/g;
+
+// from the local page store if there is one (see `wiki build-store`), otherwise the api
 async function getWiki(opt: {pageid: number}|{name: string}): Promise<Extract<z.infer<typeof WikiParseResponse>,{parse: object}>|null> {
+	const stored = await storePage(opt);
+	if (stored!=null) {
+		stored.text = stored.text.replaceAll(darkMode, "@media not all");
+		return {parse: stored};
+	}
+
 	const params = new URLSearchParams({
 		action: "parse",
 		format: "json",
@@ -310,7 +336,7 @@ async function getWiki(opt: {pageid: number}|{name: string}): Promise<Extract<z.
 		throw new AppError(resp.error.info ?? "Wikipedia API error");
 	}
 
-	resp.parse.text = resp.parse.text.replaceAll(/@media\s*\(prefers-color-scheme:\s*dark\)/g, "@media not all");
+	resp.parse.text = resp.parse.text.replaceAll(darkMode, "@media not all");
 	return resp;
 }
 
@@ -328,23 +354,20 @@ async function handleWiki(player: Player, msg: WikiMessageToServer) {
 			msg: { type: "loadingStartEnd" }
 		}));
 
-		const res = await new Deno.Command("build/wiki", {
-			args: ["select", (msg.game.minDistance ?? 0).toString()],
-			cwd: "cpp"
-		}).output();
-
-		if (!res.success)
+		const selected = await graphSelect(msg.game.minDistance ?? 0);
+		if (selected==null)
 			throw new AppError("Failed to find starting/ending articles");
 
-		const [, start, end] = decoder.decode(res.stdout).split("\n").map(x=>Number.parseInt(x));
+		const {start, end} = selected;
 		const startPage = await getWiki({pageid: start});
 		const endPage = await getWiki({pageid: end});
 
 		if (startPage==null || endPage==null)
 			throw new AppError("Start/end articles longer exist");
 
-		const path = await getDistance(startPage.parse.pageid, endPage.parse.pageid);
-		if (path==null) throw new AppError("Couldn't process path");
+		const paths = await graphPaths(startPage.parse.pageid, endPage.parse.pageid, 1);
+		if (paths==null) throw new AppError("Couldn't process path");
+		const path = paths.paths[0].pages;
 
 		const pages = await Promise.all(path.slice(1,-1).map(async x=>{
 			const res = await getWiki({pageid: x});
@@ -356,7 +379,8 @@ async function handleWiki(player: Player, msg: WikiMessageToServer) {
 			type: "wiki",
 			start,end,
 			game: msg.game,
-			playerWentTo: new Map()
+			playerWentTo: new Map(),
+			loading: new Map()
 		});
 
 		sockets.forEach(x=>x({
@@ -366,7 +390,8 @@ async function handleWiki(player: Player, msg: WikiMessageToServer) {
 				start: toWikiPage(startPage, path.length-1),
 				end: toWikiPage(endPage, 0),
 				game: msg.game,
-				path: pages.map((x,i)=>toWikiPage(x,path.length-2-i))
+				path: pages.map((x,i)=>toWikiPage(x,path.length-2-i)),
+				pathCount: paths.count
 			}
 		}));
 
@@ -413,10 +438,19 @@ async function handleWiki(player: Player, msg: WikiMessageToServer) {
 		sockets.get(player)?.({type: "wiki", msg: { type: "loadingPage" }});
 		state.playerWentTo.set(player, msg.name);
 
+		state.loading.get(player)?.abort();
+		const loading = new AbortController();
+		state.loading.set(player, loading);
+
 		dispatch(player, async ()=>{
 			const page = await getWiki({name: msg.name});
-			const dist = page!=null ? await getDistance(page.parse.pageid, state.end) : null;
-			const wikiPage = page==null || dist==null ? null : toWikiPage(page, dist.length-1);
+			if (loading.signal.aborted) return;
+
+			const dist = page!=null ? await graphDistance(page.parse.pageid, state.end, loading.signal) : null;
+			if (loading.signal.aborted) return;
+
+			if (state.loading.get(player)==loading) state.loading.delete(player);
+			const wikiPage = page==null || dist==null ? null : toWikiPage(page, dist);
 
 			addQueue(async ()=>{
 				if (gameState!=state || state.playerWentTo.get(player)!==msg.name) {
@@ -451,6 +485,8 @@ async function handleWiki(player: Player, msg: WikiMessageToServer) {
 		}));
 	} else if (msg.type=="stopLoading") {
 		state.playerWentTo.delete(player);
+		state.loading.get(player)?.abort();
+		state.loading.delete(player);
 		sockets.get(player)?.({type: "wiki", msg: {type: "loadingStopped"}});
 	}
 }
@@ -552,6 +588,12 @@ const AdminCommand = z.union([
 	}),
 	z.object({
 		type: z.literal("status")
+	}),
+	z.object({
+		type: z.literal("stats")
+	}),
+	z.object({
+		type: z.literal("reloadGraph")
 	})
 ]);
 
@@ -567,6 +609,9 @@ export type AdminResponse = {
 		type: "wiki"|"mine",
 		start: number
 	}|null
+}|{
+	type: "stats",
+	engines: EngineStats|null
 };
 
 const adminToken = doHash(process.env["ADMIN_PASSWORD"]!);
@@ -594,6 +639,17 @@ app.post("/admin", authAdmin, async c=>{
 				start: gameState.start
 			} : null
 		} satisfies AdminResponse);
+	} else if (cmd.type=="stats") {
+		return c.json({
+			type: "stats",
+			engines: engineStats()
+		} satisfies AdminResponse);
+	} else if (cmd.type=="reloadGraph") {
+		try {
+			await reloadGraph();
+		} catch (e) {
+			throw new AppError(e instanceof Error ? e.message : "couldn't reload graph");
+		}
 	}
 
 	return c.json({type: "ok"});
@@ -3,7 +3,7 @@ import { Anchor, Button, Container, Heading, Highlighted, Input, Spinner, WinMod
 import { Ctx, useTimeUntil } from "./util";
 import { motion } from "motion/react";
 import { IconBombFilled, IconEyeFilled, IconFlag2Filled, IconSkull } from "@tabler/icons-react";
-import { ActiveMineState, countMineState, DEATH_LIMIT, MineState, mineStateCellDifference } from "./minestate";
+import { ActiveMineState, countMineState, DEATH_LIMIT, MineState, mineStateCellDifference, mineStateKnown } from "./minestate";
 import { MineMessageToServer, TimeRecord } from "./server";
 import clsx from "clsx";
 
@@ -127,9 +127,10 @@ const colors = [
 	"#fcd34d"
 ] as const;
 
-export function MineCell({cell, flag, end, reveal, delta, active: umActive, setActive, clearActive}: {
+export function MineCell({cell, flag, end, reveal, delta, hintSafe, active: umActive, setActive, clearActive}: {
 	cell: ActiveMineState["board"][0][0],
 	end: boolean,
+	hintSafe: boolean,
 	delta: number,
 	flag: ()=>void, reveal: ()=>void,
 	active: boolean, setActive: ()=>void, clearActive: ()=>void
@@ -144,7 +145,7 @@ export function MineCell({cell, flag, end, reveal, delta, active: umActive, setA
 			canActivate ? "cursor-pointer" : "cursor-not-allowed",
 			isMine ? "bg-white"
 			: cell.revealed[0] ? (delta<0 ? "bg-red-800" : cell.revealed[1] ? "bg-rose-900/20" : "bg-zinc-900")
-			: "bg-neutral-700"
+			: hintSafe ? "bg-emerald-800" : "bg-neutral-700"
 	)}
 		whileTap={canActivate ? {scale: 1.3, outlineWidth: "5px", zIndex: 30} : {}}
 		animate={{background: active ? "#3b3f47" : "", outlineColor: active ? "#b0c1d1" : "#3c3c3d", outlineWidth: active ? "2px" : "1px"}}
@@ -207,6 +208,12 @@ export function ActiveMines({send, state}: {
 
 	const total = state.size[0]*state.size[1]-state.nMine;
 
+	const hintSafe = useMemo(()=>{
+		const safe = new Set<number>();
+		if (state.status=="ongoing") state.hint?.safe.forEach(([i,j])=>safe.add(i*state.size[1]+j));
+		return safe;
+	}, [state]);
+
 	const smX = state.size[0]<=10, smY = state.size[1]<=10;
 	return <div className={clsx("flex flex-row justify-between gap-10 self-stretch",
 		smX ? "px-40 pr-60" : "pr-14 pl-9",
@@ -270,6 +277,7 @@ export function ActiveMines({send, state}: {
 				</div>
 			</div>
 
+			{state.status=="ongoing" && active && <Button onClick={()=>send({type: "hint", known: mineStateKnown(active)})} >Hint</Button>}
 			<Button onClick={()=>send({type: "closeGame"})} >{isEnd ? "Play again?" : "End game"}</Button>
 		</div>
 
@@ -280,6 +288,7 @@ export function ActiveMines({send, state}: {
 						const isActive = activeCell!=null && i==activeCell[0] && j==activeCell[1] && !isEnd;
 						return <MineCell key={j} cell={active ? active.board[i][j] : emptyCell}
 							end={isEnd}
+							hintSafe={hintSafe.has(i*state.size[1]+j)}
 							delta={active ? mineStateCellDifference(active,i,j) ?? 1 : 1}
 							active={isActive}
 							setActive={()=>setActive([i,j])} clearActive={()=>setActive(null)}
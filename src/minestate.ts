@@ -1,4 +1,4 @@
-import { MineMessageToClient, MineMessageToServer, Player } from "./server";
+import { MineHint, MineMessageToClient, MineMessageToServer, Player } from "./server";
 
 export const DEATH_LIMIT = 2;
 
@@ -17,7 +17,8 @@ export type ActiveMineState = Readonly<BaseMineState&{
 		number: number
 	}>[][],
 	startSquare: readonly [number, number],
-	start: number
+	start: number,
+	hint?: MineHint|null
 }>;
 
 export type MineLeaderboard = {
@@ -121,6 +122,11 @@ export function countMineState(m: ActiveMineState, idx: 0|1, which: "flag"|"reve
 		),0);
 }
 
+// board as the solver sees it: revealed numbers, -1 for unknown (and for mines we died on)
+export function mineStateKnown(m: ActiveMineState) {
+	return m.board.map(row=>row.map(cell=>cell.revealed[0] && !cell.mine ? cell.number : -1));
+}
+
 export function mineStateCellDifference(m: ActiveMineState, i: number, j: number) {
 	let d = m.board[i][j].number;
 	let unknown=false;
@@ -164,11 +170,14 @@ export function reduceMineState(state: MineState, msg: MineMessageToClient, play
 		};
 	} else if (state.status=="ongoing") {
 		if (msg.type=="playerReveal") {
-			const newState=checkEnd(reveal(state, msg.player==player ? 0 : 1, msg.square[0], msg.square[1]), msg.time);
+			const revealed = reveal(state, msg.player==player ? 0 : 1, msg.square[0], msg.square[1]);
+			const newState=checkEnd(msg.player==player ? {...revealed, hint: undefined} : revealed, msg.time);
 			if (newState.status=="won" && newState.why=="speed") send({type: "addTime"});
 			return newState;
 		} else if (msg.type=="playerFlag") {
 			return {...flag(state, msg.player==player ? 0 : 1, msg.square[0], msg.square[1]), status: "ongoing"};
+		} else if (msg.type=="hint") {
+			return {...state, hint: msg.hint};
 		}
 	} else {
 		if (msg.type=="timeAdded") {
@@ -7,11 +7,25 @@ export type Game = {
 
 export type Player = "one"|"two";
 
+// bounds on solver-derived metrics of generated boards
+export type MineDifficulty = {
+	deductions?: readonly [number, number],
+	depth?: number,
+	bbbv?: readonly [number, number]
+};
+
 export type TimeRecord = {
 	name: string|null, seconds: number,
 	size: readonly [number, number, number]
 };
 
+// cells provably safe / mines and each cell's mine probability given one player's board
+export type MineHint = {
+	safe: [number, number][],
+	mine: [number, number][],
+	prob: number[][]
+};
+
 export type WikiPage = {
 	name: string,
 	distance: number,
@@ -49,6 +63,8 @@ export type WikiMessageToClient = {
 	start: WikiPage,
 	end: WikiPage,
 	path: WikiPage[],
+	// # of shortest paths, path is one of them
+	pathCount: number,
 	game: WikiGameType
 } | ({
 	type: "stopped",
@@ -108,6 +124,9 @@ export type MineMessageToClient = {
 } | {
 	type: "timeNameSet",
 	name: string
+} | {
+	type: "hint",
+	hint: MineHint|null
 };
 
 export type MineMessageToServer = ({
@@ -117,7 +136,10 @@ export type MineMessageToServer = ({
 )) | {
 	type: "startGame",
 	size: readonly [number, number],
-	nMine: number
+	nMine: number,
+	difficulty?: MineDifficulty,
+	//same seed, size, start and difficulty always gives the same board
+	seed?: number
 } | {
 	type: "getTimes",
 	size: readonly [number, number, number]|null,
@@ -127,6 +149,10 @@ export type MineMessageToServer = ({
 	name: string
 } | {
 	type: "addTime"
+} | {
+	type: "hint",
+	// revealed numbers, -1 for unknown
+	known: number[][]
 };
 
 export type MessageToClient = {
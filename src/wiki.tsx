@@ -319,7 +319,7 @@ function WikiGame({state, send}: {
 			{showDegs && <Degs x={state.playerState[1].distance} desc="your opponent" />}
 
 			{state.status=="end" && <>
-				<b>Optimal path</b>
+				<b>Optimal path{state.pathCount>1 && ` (one of ${state.pathCount.toLocaleString()})`}</b>
 				{hist("path")}
 			</>}
 
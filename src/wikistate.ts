@@ -28,7 +28,8 @@ export type ActiveWikiState = Readonly<{
 export type BaseWikiState = {
 	game: WikiGameType,
 	start: WikiPage, end: WikiPage,
-	path: WikiPage[]
+	path: WikiPage[],
+	pathCount: number
 };
 
 export type WikiState = Readonly<{status: "idle"}|{status: "loading"}|(BaseWikiState&(